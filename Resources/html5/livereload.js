@@ -0,0 +1,125 @@
+// Live reload of the test page served by the editor. Only included in the page when testing in
+// the browser: the editor pushes the paths of the files that changed after each generation, and
+// the changed scripts are run again in place instead of reloading the whole page.
+(function() {
+    let version = -1;
+    let pageScripts = ['js/wave.js', 'js/audio.js'];
+
+    // Decoded audio outlives the scripts, see DecodableAudio in wave.js
+    window.decodedAudioCache = {};
+
+    // The contexts and load listeners created by the page's scripts, to be released on reload
+    let NativeAudioContext = window.AudioContext || window.webkitAudioContext;
+    let contexts = [];
+    let loadListeners = [];
+
+    window.AudioContext = function (options) {
+        let ctx = new NativeAudioContext (options);
+        contexts.push (ctx);
+        return ctx;
+    };
+
+    window.AudioContext.prototype = NativeAudioContext.prototype;
+
+    let nativeAddEventListener = window.addEventListener;
+
+    window.addEventListener = function (type, listener, options) {
+        if (type === 'load')
+            loadListeners.push (listener);
+
+        nativeAddEventListener.call (window, type, listener, options);
+    };
+
+    let releasePageScripts = function() {
+        for (let ctx of contexts)
+            ctx.close();
+
+        for (let listener of loadListeners)
+            window.removeEventListener ('load', listener);
+
+        contexts = [];
+        loadListeners = [];
+
+        let controllers = document.querySelector ('#controllers');
+
+        if (controllers !== null)
+            controllers.innerHTML = '';
+    };
+
+    // Scripts are run again in the page's order, then get the load event they expect
+    let reloadScripts = function (paths) {
+        releasePageScripts();
+
+        let remaining = paths.slice();
+
+        let loadNext = function() {
+            if (remaining.length === 0) {
+                window.dispatchEvent (new Event ('load'));
+                return;
+            }
+
+            let path = remaining.shift();
+            let previous = document.querySelector ('script[data-path="' + path + '"]')
+                        || document.querySelector ('script[src="' + path + '"]');
+
+            let script = document.createElement ('script');
+            script.src = path + '?v=' + version;
+            script.setAttribute ('data-path', path);
+            script.onload = loadNext;
+            script.onerror = loadNext;
+
+            if (previous !== null)
+                previous.parentNode.replaceChild (script, previous);
+            else
+                document.head.appendChild (script);
+        };
+
+        loadNext();
+    };
+
+    let reloadStyleSheet = function() {
+        let link = document.querySelector ('link[rel="stylesheet"]');
+
+        if (link !== null)
+            link.href = 'style.css?v=' + version;
+    };
+
+    let applyChanges = function (changes) {
+        if (changes.reload || changes.changed.indexOf ('index.html') >= 0 || changes.changed.indexOf ('js/livereload.js') >= 0) {
+            window.location.reload();
+            return;
+        }
+
+        let scriptsToReload = [];
+
+        for (let path of changes.changed) {
+            if (path.indexOf ('data/') === 0)
+                delete window.decodedAudioCache['/' + path];
+            else if (path === 'style.css')
+                reloadStyleSheet();
+        }
+
+        // An audio file change is only heard once the graph is rebuilt
+        let audioChanged = changes.changed.some (function (path) { return path.indexOf ('data/') === 0; });
+
+        for (let path of pageScripts)
+            if (audioChanged || changes.changed.indexOf (path) >= 0)
+                scriptsToReload.push (path);
+
+        if (scriptsToReload.length > 0)
+            reloadScripts (scriptsToReload);
+    };
+
+    // A single stream stays open. When it breaks, EventSource opens it again by itself and
+    // passes the id of the last event it got, so that the changes made meanwhile come first.
+    let source = new EventSource ('/live');
+
+    source.onmessage = function (event) {
+        let changes = JSON.parse (event.data);
+        let isFirstEvent = version < 0;
+        version = changes.version;
+
+        if (! isFirstEvent)
+            applyChanges (changes);
+    };
+})();
@@ -1,12 +1,83 @@
-function AudioPredecoder() {
+function AudioBundle (url) {
+    this.entries = {};
+    this.data = null;
+    let that = this;
+    
+    this.load = function (onLoaded) {
+        let request = new XMLHttpRequest();
+        request.open('GET', url, true);
+        request.responseType = 'arraybuffer';
+        
+        request.onload = function() {
+            if (request.status === 200)
+                that.parse (request.response);
+            
+            onLoaded();
+        }
+        
+        request.onerror = function() {
+            onLoaded();
+        }
+        
+        request.send();
+    }
+    
+    // "WAVB", index length (uint32, little endian), JSON index, then the files' data
+    this.parse = function (arrayBuffer) {
+        if (arrayBuffer.byteLength < 8)
+            return;
+        
+        let view = new DataView (arrayBuffer);
+        let magic = String.fromCharCode (view.getUint8 (0), view.getUint8 (1), view.getUint8 (2), view.getUint8 (3));
+        
+        if (magic !== "WAVB")
+            return;
+        
+        let indexLength = view.getUint32 (4, true);
+        let index = JSON.parse (new TextDecoder().decode (new Uint8Array (arrayBuffer, 8, indexLength)));
+        let dataStart = 8 + indexLength;
+        
+        for (let entry of index)
+            this.entries[entry.url] = { offset: dataStart + entry.offset, size: entry.size };
+        
+        this.data = arrayBuffer;
+    }
+    
+    // Returns a copy of a file's data as decodeAudioData detaches the buffer it's given,
+    // or null if the file isn't in the bundle
+    this.getData = function (url) {
+        let entry = this.entries[url];
+        
+        if (this.data === null || entry === undefined)
+            return null;
+        
+        return this.data.slice (entry.offset, entry.offset + entry.size);
+    }
+    
+    return this;
+};
+
+function AudioPredecoder (bundleUrl) {
     this.onSuccess = function() {}
     
     this.buffersToDecode = [];
+    
+    // With a bundle, all the files are fetched in a single request
+    this.bundle = bundleUrl === undefined ? null : new AudioBundle (bundleUrl);
 
     this.predecode = function() {
-        for (buffer of this.buffersToDecode)
-            if (buffer.shouldPredecode)
-                buffer.decode();
+        let that = this;
+        
+        let decodeAll = function() {
+            for (let buffer of that.buffersToDecode.slice())
+                if (buffer.shouldPredecode)
+                    buffer.decode();
+        }
+        
+        if (this.bundle !== null && this.bundle.data === null)
+            this.bundle.load (decodeAll);
+        else
+            decodeAll();
     }
 
     this.audioFinishedDecoded = function() {
@@ -25,7 +96,20 @@ function DecodableAudio (predecoder, ctx, useFileChooser, url, predecode) {
     predecoder.buffersToDecode.push (this);
     
     this.decode = function() {
-        getData (url);
+        // Set by the test page's live reload, so that reloaded scripts don't decode the files again
+        let cache = window.decodedAudioCache;
+        
+        if (cache !== undefined && cache[url] !== undefined) {
+            onDecodeSuccess.call (that, cache[url]);
+            return;
+        }
+        
+        let bundledData = predecoder.bundle === null ? null : predecoder.bundle.getData (url);
+        
+        if (bundledData !== null)
+            decodeData (bundledData);
+        else
+            getData (url);
     }
     
     function getData (url) {
@@ -34,17 +118,24 @@ function DecodableAudio (predecoder, ctx, useFileChooser, url, predecode) {
         request.responseType = 'arraybuffer';
         
         request.onload = function() {
-            let audioData = request.response;
-            ctx.decodeAudioData(audioData,
-                                onDecodeSuccess.bind (that),
-                                onDecodeError.bind (that));
+            decodeData (request.response);
         }
         
         request.send();
     }
     
+    function decodeData (audioData) {
+        ctx.decodeAudioData(audioData,
+                            onDecodeSuccess.bind (that),
+                            onDecodeError.bind (that));
+    }
+    
     function onDecodeSuccess (newBuffer) {
         this.buffer = newBuffer;
+        
+        if (window.decodedAudioCache !== undefined)
+            window.decodedAudioCache[url] = newBuffer;
+        
         predecoder.buffersToDecode.splice (predecoder.buffersToDecode.indexOf (this), 1);
         
         predecoder.audioFinishedDecoded();
@@ -0,0 +1,85 @@
+#include "HeadlessProject.h"
+
+String HeadlessProject::load (const File& fileToLoad)
+{
+    projectFile = fileToLoad;
+    
+    // Not the saved "directory": it's absolute and still points to the original project
+    // when the file was moved or copied
+    projectDirectory = fileToLoad.getParentDirectory();
+    graphModel.clear();
+    audioFiles.clearQuick();
+    audioFileListFound = false;
+    transcodeSettings = AudioTranscoder::Settings();
+    useAudioBundle = false;
+    optimizeGraph = false;
+    eliminateDeadNodes = true;
+    
+    XmlDocument xmlDoc (fileToLoad);
+    ScopedPointer<XmlElement> element = xmlDoc.getDocumentElement();
+    
+    if (element == nullptr)
+        return "can't parse project file (" + xmlDoc.getLastParseError() + ")";
+    
+    // Same tag as Project::projectFileTagName
+    if (element->getTagName() != "WAVEProject")
+        return "not a project file";
+    
+    if (auto projectConf = element->getChildByName ("ProjectConfig"))
+    {
+        PropertySet ps;
+        ps.restoreFromXml (*projectConf);
+        
+        transcodeSettings.loadFrom (ps);
+        useAudioBundle = ps.getBoolValue ("audioBundle", false);
+        optimizeGraph = ps.getBoolValue ("optimizeGraph", false);
+        eliminateDeadNodes = ps.getBoolValue ("eliminateDeadNodes", true);
+    }
+    else
+    {
+        return "missing project config";
+    }
+    
+    auto panelsXml = element->getChildByName ("Panels");
+    
+    if (panelsXml == nullptr)
+        return "missing panels state";
+    
+    bool graphFound = false;
+    
+    forEachXmlChildElement (*panelsXml, item)
+    {
+        if (item->hasTagName ("WebAudioGraph"))
+        {
+            if (auto graphXml = item->getChildByName ("GraphPanel"))
+                graphFound = graphModel.loadFromXml (*graphXml);
+        }
+        else if (item->hasTagName ("AudioFilesPanel"))
+        {
+            loadAudioFiles (*item);
+            audioFileListFound = true;
+        }
+    }
+    
+    if (! graphFound)
+        return "missing audio graph";
+    
+    // Same as Project::getName()
+    graphModel.setPageTitle (projectFile.getFileNameWithoutExtension());
+    
+    return String();
+}
+
+void HeadlessProject::loadAudioFiles (const XmlElement& xml)
+{
+    forEachXmlChildElementWithTagName (xml, item, "AudioFile")
+    {
+        auto file = projectDirectory.getChildFile (item->getStringAttribute ("relativePath"));
+        
+        // If the file can't be found with the relative path, try with the absolute one
+        if (! file.existsAsFile())
+            file = File (item->getStringAttribute ("fullPath"));
+        
+        audioFiles.add ({ file, item->getStringAttribute ("alias") });
+    }
+}
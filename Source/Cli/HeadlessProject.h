@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WebAudioGraphModel.h"
+#include "WebAudioOutputWriter.h"
+#include "AudioTranscoder.h"
+
+// Reads what the generator needs from a .waveproj file, without creating the project's panels.
+class HeadlessProject
+{
+public:
+    HeadlessProject() {}
+    
+    // Returns an error message, or an empty string if the project was loaded
+    String load (const File& fileToLoad);
+    
+    const File& getProjectFile() const { return projectFile; }
+    const File& getProjectDirectory() const { return projectDirectory; }
+    File getOutputDirectory() const { return projectDirectory.getChildFile ("output"); }
+    
+    // Same location as RootWebAudioGraphPanel::getTranscodeCacheDirectory()
+    File getTranscodeCacheDirectory() const { return projectDirectory.getChildFile ("cache").getChildFile ("transcoded"); }
+    const AudioTranscoder::Settings& getTranscodeSettings() const { return transcodeSettings; }
+    bool isUsingAudioBundle() const { return useAudioBundle; }
+    bool isOptimizingGraph() const { return optimizeGraph; }
+    bool isEliminatingDeadNodes() const { return eliminateDeadNodes; }
+    
+    const WebAudioGraphModel& getGraphModel() const { return graphModel; }
+    const Array<WebAudioOutputWriter::AudioFile>& getAudioFiles() const { return audioFiles; }
+    
+    // False when the project has no audio files panel, the list of audio files is then unknown
+    bool hasAudioFileList() const { return audioFileListFound; }
+    
+private:
+    void loadAudioFiles (const XmlElement& audioFilesPanelXml);
+    
+    File projectFile;
+    File projectDirectory;
+    WebAudioGraphModel graphModel;
+    Array<WebAudioOutputWriter::AudioFile> audioFiles;
+    bool audioFileListFound = false;
+    AudioTranscoder::Settings transcodeSettings;
+    bool useAudioBundle = false;
+    bool optimizeGraph = false;
+    bool eliminateDeadNodes = true;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HeadlessProject)
+};
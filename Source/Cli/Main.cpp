@@ -0,0 +1,249 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "HeadlessProject.h"
+#include "WebAudioGraphCodeGenerator.h"
+#include "WebAudioOutputWriter.h"
+
+//==============================================================================
+// Command-line generator: runs the same pipeline as RootWebAudioGraphPanel::generateOutput()
+// on any number of projects without creating any window.
+//
+// Usage: WaveCli [--quiet] [--optimize] [--keep-dead-nodes] [--transcode ogg|flac|none] [--sample-rate <Hz>]
+//               [--channels <n>] [--bundle] <project.waveproj | directory> ...
+//        WaveCli --run-tests
+// Directories are searched recursively for project files. The transcoding, bundle, optimize and
+// dead nodes options override the ones saved in the projects.
+
+// Settings given on the command line, unset values keep the project's
+struct ProjectOverrides
+{
+    void applyTo (AudioTranscoder::Settings& settings) const
+    {
+        if (format.isNotEmpty())
+            settings.format = AudioTranscoder::Settings::getFormatWithName (format);
+        
+        if (sampleRate >= 0.0)
+            settings.sampleRate = sampleRate;
+        
+        if (numChannels >= 0)
+            settings.numChannels = numChannels;
+    }
+    
+    String format;
+    double sampleRate = -1.0;
+    int numChannels = -1;
+    bool forceAudioBundle = false;
+    bool forceOptimization = false;
+    bool keepDeadNodes = false;
+};
+
+struct PhaseTimings
+{
+    double load = 0.0;
+    double sync = 0.0;
+    double generate = 0.0;
+    double write = 0.0;
+    
+    double getTotal() const { return load + sync + generate + write; }
+    
+    void add (const PhaseTimings& other)
+    {
+        load += other.load;
+        sync += other.sync;
+        generate += other.generate;
+        write += other.write;
+    }
+    
+    String toString() const
+    {
+        auto ms = [] (double v) { return String (v, 2) + " ms"; };
+        
+        return "load " + ms (load)
+            + ", sync " + ms (sync)
+            + ", generate " + ms (generate)
+            + ", write " + ms (write)
+            + " (total " + ms (getTotal()) + ")";
+    }
+};
+
+// Measures the time spent since construction or since the last call to lap()
+struct PhaseTimer
+{
+    double lap()
+    {
+        const double now = Time::getMillisecondCounterHiRes();
+        const double elapsed = now - start;
+        start = now;
+        return elapsed;
+    }
+    
+    double start = Time::getMillisecondCounterHiRes();
+};
+
+static bool generateProject (const File& projectFile, WebAudioGraphGenerator& generator,
+                             const ProjectOverrides& overrides, PhaseTimings& timings, String& error)
+{
+    PhaseTimer timer;
+    
+    HeadlessProject project;
+    error = project.load (projectFile);
+    timings.load = timer.lap();
+    
+    if (error.isNotEmpty())
+        return false;
+    
+    WebAudioOutputWriter writer (project.getOutputDirectory());
+    
+    if (! writer.prepareDirectories())
+    {
+        error = "can't create output directory " + project.getOutputDirectory().getFullPathName();
+        return false;
+    }
+    
+    auto transcodeSettings = project.getTranscodeSettings();
+    overrides.applyTo (transcodeSettings);
+    
+    const AudioTranscoder transcoder (transcodeSettings, project.getTranscodeCacheDirectory());
+    const bool useBundle = project.isUsingAudioBundle() || overrides.forceAudioBundle;
+    const auto syncResult = writer.syncAudioFiles (project.getAudioFiles(), &transcoder, useBundle,
+                                                   project.hasAudioFileList());
+    timings.sync = timer.lap();
+    
+    if (syncResult.numFailed > 0)
+    {
+        error = String (syncResult.numFailed) + " audio file(s) couldn't be copied";
+        return false;
+    }
+    
+    for (auto& collision : syncResult.nameCollisions)
+        std::cerr << projectFile.getFullPathName() << ": warning: " << collision << std::endl;
+    
+    for (auto& name : syncResult.untranscodedFiles)
+        std::cerr << projectFile.getFullPathName() << ": warning: " << name
+                  << " couldn't be transcoded, it is delivered as is" << std::endl;
+    
+    generator.setRenamedAudioFiles (syncResult.renamedFiles);
+    generator.setAudioBundleUrl (useBundle ? WebAudioOutputWriter::getAudioBundleUrl() : String());
+    generator.setOptimizationEnabled (project.isOptimizingGraph() || overrides.forceOptimization);
+    generator.setDeadNodeEliminationEnabled (project.isEliminatingDeadNodes() && ! overrides.keepDeadNodes);
+    generator.generate (project.getGraphModel());
+    timings.generate = timer.lap();
+    
+    writer.writeGeneratedFiles (generator);
+    timings.write = timer.lap();
+    
+    return true;
+}
+
+// Runs the UnitTests linked in the tool (see Source/Tests). Returns the number of failures.
+static int runUnitTests()
+{
+    UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runAllTests();
+    
+    int numFailures = 0;
+    
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+    
+    return numFailures;
+}
+
+static Array<File> findProjectFiles (const StringArray& paths)
+{
+    Array<File> result;
+    
+    for (auto& path : paths)
+    {
+        const auto f = File::getCurrentWorkingDirectory().getChildFile (path.unquoted());
+        
+        if (f.isDirectory())
+        {
+            auto found = f.findChildFiles (File::findFiles, true, "*.waveproj");
+            found.sort();
+            result.addArray (found);
+        }
+        else
+        {
+            result.add (f);
+        }
+    }
+    
+    return result;
+}
+
+int main (int argc, char* argv[])
+{
+    StringArray paths;
+    bool quiet = false;
+    ProjectOverrides overrides;
+    
+    StringArray args;
+    
+    for (int i = 1; i < argc; ++i)
+        args.add (CharPointer_UTF8 (argv[i]));
+    
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const auto& arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+        
+        if (arg == "--run-tests")
+            return runUnitTests() > 0 ? 1 : 0;
+        else if (arg == "--quiet" || arg == "-q")
+            quiet = true;
+        else if (arg == "--optimize")
+            overrides.forceOptimization = true;
+        else if (arg == "--keep-dead-nodes")
+            overrides.keepDeadNodes = true;
+        else if (arg == "--transcode" && hasValue)
+            overrides.format = args[++i];
+        else if (arg == "--sample-rate" && hasValue)
+            overrides.sampleRate = args[++i].getDoubleValue();
+        else if (arg == "--channels" && hasValue)
+            overrides.numChannels = args[++i].getIntValue();
+        else if (arg == "--bundle")
+            overrides.forceAudioBundle = true;
+        else
+            paths.add (arg);
+    }
+    
+    if (paths.isEmpty())
+    {
+        std::cout << "Usage: WaveCli [--quiet] [--optimize] [--keep-dead-nodes] [--transcode ogg|flac|none] [--sample-rate <Hz>]"
+                  << " [--channels <n>] [--bundle]"
+                  << " <project.waveproj | directory> ..." << std::endl
+                  << "       WaveCli --run-tests" << std::endl;
+        return 1;
+    }
+    
+    const auto projectFiles = findProjectFiles (paths);
+    
+    WebAudioGraphGenerator generator;
+    PhaseTimings totalTimings;
+    int numFailed = 0;
+    
+    for (auto& projectFile : projectFiles)
+    {
+        PhaseTimings timings;
+        String error;
+        
+        if (generateProject (projectFile, generator, overrides, timings, error))
+        {
+            if (! quiet)
+                std::cout << projectFile.getFullPathName() << ": " << timings.toString() << std::endl;
+        }
+        else
+        {
+            std::cerr << projectFile.getFullPathName() << ": " << error << std::endl;
+            ++numFailed;
+        }
+        
+        totalTimings.add (timings);
+    }
+    
+    std::cout << String (projectFiles.size() - numFailed) << " of " << String (projectFiles.size())
+              << " projects generated: " << totalTimings.toString() << std::endl;
+    
+    return numFailed > 0 ? 1 : 0;
+}
@@ -46,6 +46,14 @@ void GraphDragger::dragSelection (const MouseEvent& e)
     
     const Point<int> offset (offsetX, offsetY);
     
+    auto& graphPanel = selector.getGraphPanel();
+    
+    // Moved components repaint their old and new bounds themselves: only their cables, before
+    // and after the move, are added to the dirty region
+    RectangleList<int> dirtyRegion;
+    addDraggedConnectionAreas (dirtyRegion);
+    graphPanel.beginDirtyRegionUpdate();
+    
     if (e.mods.isShiftDown())
     {
         for (auto item : itemsToDrag)
@@ -60,24 +68,43 @@ void GraphDragger::dragSelection (const MouseEvent& e)
                 item->latestPositionShifted = item->component->getPosition() - offset;
             }
         }
-        
-        return;
     }
-    
-    for (auto item : itemsToDrag)
+    else
     {
-        if (auto comp = item->component)
+        for (auto item : itemsToDrag)
         {
-            comp->setTopLeftPosition (offset + item->latestPositionShifted);
-            comp->wasDragged (e, false, itemsToDrag.size() == 1);
+            if (auto comp = item->component)
+            {
+                comp->setTopLeftPosition (offset + item->latestPositionShifted);
+                comp->wasDragged (e, false, itemsToDrag.size() == 1);
+            }
         }
     }
+    
+    addDraggedConnectionAreas (dirtyRegion);
+    graphPanel.endDirtyRegionUpdate (dirtyRegion);
+}
+
+void GraphDragger::addDraggedConnectionAreas (RectangleList<int>& dirtyRegion) const
+{
+    auto& graphPanel = selector.getGraphPanel();
+    
+    for (auto item : itemsToDrag)
+        if (auto comp = item->component)
+            for (auto connection : graphPanel.getConnectionsForComponent (comp))
+                dirtyRegion.add (connection->getPathBounds());
 }
 
 
 void GraphDragger::stopDragging (const MouseEvent& e)
 {
-    selector.getGraphPanel().getUndoManager().beginNewTransaction();
+    // Consecutive drags of the same selection are undone at once
+    String transactionName ("Move");
+    
+    for (auto item : itemsToDrag)
+        transactionName << " " << item->component->getGraphId();
+    
+    selector.getGraphPanel().beginCoalescedTransaction (transactionName);
     
     if (e.mouseWasDraggedSinceMouseDown())
         for (auto item : itemsToDrag)
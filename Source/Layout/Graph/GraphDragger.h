@@ -39,6 +39,9 @@ private:
     /** \brief Determines the maximum drag offset for the current items. */
     void setConstrainer ();
     
+    /** \brief Adds the bounds of the dragged components' cables to a dirty region. */
+    void addDraggedConnectionAreas (RectangleList<int>& dirtyRegion) const;
+    
     /** \brief Holds a pointer to a dragged GraphEmbeddedComponent as well as its initial position when startDragging was called. */
     struct DraggedComponent
     {
@@ -84,7 +84,14 @@ void GraphEmbeddedComponent::setParentGraph (GraphPanel* parent)
 
 void GraphEmbeddedComponent::setGraphId (int newGraphId)
 {
+    if (graphId == newGraphId)
+        return;
+    
+    const int previousId = graphId;
     graphId = newGraphId;
+    
+    if (parentGraphPanel != nullptr)
+        parentGraphPanel->graphIdChanged (this, previousId);
 }
 
 #include "GraphDragger.h"
@@ -210,10 +217,21 @@ void GraphEmbeddedComponent::paint(Graphics &g)
 
 void GraphEmbeddedComponent::resized()
 {
+    if (parentGraphPanel != nullptr)
+        parentGraphPanel->embeddedBoundsChanged (this);
+    
     resizePins();
     resizeUI (getLocalBounds().reduced(2));
 }
 
+void GraphEmbeddedComponent::moved()
+{
+    if (parentGraphPanel != nullptr)
+        parentGraphPanel->embeddedBoundsChanged (this);
+    
+    graphItemChanged();
+}
+
 void GraphEmbeddedComponent::deleteSelectedItem()
 {
     if (parentGraphPanel != nullptr && canBeDeleted())
@@ -428,7 +446,11 @@ void GraphEmbeddedComponent::setNumPinsUpTo (Pin::Placement placement, int num)
 void GraphEmbeddedComponent::disconnectPin (Pin* pin, bool undoable)
 {
     if (pin != nullptr && pin->isConnected() && parentGraphPanel != nullptr)
-        for (auto connection : parentGraphPanel->getConnections())
-            if (connection->getSourcePin() == pin || connection->getDestinationPin() == pin)
-                parentGraphPanel->removeConnectionBetween(connection->getSourcePin(), connection->getDestinationPin(), undoable);
+    {
+        // Work on a copy as the index is modified by each removal
+        const Array<GraphPanel::Connection*> pinConnections (parentGraphPanel->getConnectionsForPin (pin));
+        
+        for (auto connection : pinConnections)
+            parentGraphPanel->removeConnectionBetween (connection->getSourcePin(), connection->getDestinationPin(), undoable);
+    }
 }
@@ -39,7 +39,7 @@ public:
     
     void paint(Graphics &g) override;
     void resized() override;
-    void moved() override { graphItemChanged(); }
+    void moved() override;
     
     Colour getBackgroundColour() const { return backgroundColour; }
     virtual void setBackgroundColour (Colour newColour)
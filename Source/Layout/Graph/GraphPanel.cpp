@@ -9,6 +9,7 @@
 */
 
 #include "GraphPanel.h"
+#include "HashMapHelpers.h"
 
 
 //==============================================================================
@@ -51,22 +52,39 @@ ConnectionInfo GraphPanel::Connection::getInfo()
                            this);
 }
 
-void GraphPanel::Connection::paint (Graphics &g)
+bool GraphPanel::Connection::updatePath()
 {
-    const Point<float> sourcePoint (getPinCentreInGraph (sourcePin).toFloat());
-    const Point<float> destPoint (getPinCentreInGraph (destPin).toFloat());
+    const Point<int> sourceCentre (getPinCentreInGraph (sourcePin));
+    const Point<int> destCentre (getPinCentreInGraph (destPin));
     
+    if (pathIsValid && sourceCentre == lastSourceCentre && destCentre == lastDestCentre)
+        return false;
+    
+    lastSourceCentre = sourceCentre;
+    lastDestCentre = destCentre;
+    pathIsValid = true;
+    
+    path = createConnectionPath (sourceCentre.toFloat(), destCentre.toFloat(), sourcePin->getPlacement(), destPin->getPlacement());
+    
+    hitPath.clear();
+    PathStrokeType wideStroke (8.0f);
+    wideStroke.createStrokedPath (hitPath, path);
+    
+    pathBounds = hitPath.getBounds().getSmallestIntegerContainer().expanded (1);
+    return true;
+}
+
+void GraphPanel::Connection::paintConnection (Graphics& g) const
+{
     const int stroke = isSelected() ? 4 : 2;
     const Colour baseColour = isValid ? Colours::black : Colours::grey;
     const Colour colour = (isHighlighted() || isSelected()) ? baseColour : baseColour.withAlpha (0.7f);
-        
-    Path p (drawConnection (sourcePoint, destPoint, stroke, colour, sourcePin->getPlacement(), destPin->getPlacement(), g));
     
-    PathStrokeType wideStroke (8.0f);
-    wideStroke.createStrokedPath (hitPath, p);
+    g.setColour (colour);
+    g.strokePath (path, PathStrokeType (stroke));
 }
 
-Path GraphPanel::Connection::drawConnection (Point<float> from, Point<float> to, int stroke, Colour colour, Pin::Placement sourcePlacement, Pin::Placement destPlacement, Graphics &g)
+Path GraphPanel::Connection::createConnectionPath (Point<float> from, Point<float> to, Pin::Placement sourcePlacement, Pin::Placement destPlacement)
 {
     const int offsetX = to.getX() - from.getX();
     const int offsetY = to.getY() - from.getY();
@@ -88,6 +106,13 @@ Path GraphPanel::Connection::drawConnection (Point<float> from, Point<float> to,
     Path p;
     p.startNewSubPath(from);
     p.cubicTo (cp1, cp2, to);
+    
+    return p;
+}
+
+Path GraphPanel::Connection::drawConnection (Point<float> from, Point<float> to, int stroke, Colour colour, Pin::Placement sourcePlacement, Pin::Placement destPlacement, Graphics &g)
+{
+    Path p (createConnectionPath (from, to, sourcePlacement, destPlacement));
     g.setColour(colour);
     g.strokePath(p, PathStrokeType(stroke));
     
@@ -152,7 +177,14 @@ Point<int> GraphPanel::Connection::getControlPoint (Point<int> pinCentre, Pin::P
 
 void GraphPanel::Connection::graphEmbeddedChanged()
 {
-    repaint();
+    if (graphPanel != nullptr)
+        graphPanel->connectionLayer.connectionMoved (this);
+}
+
+void GraphPanel::Connection::appearanceChanged()
+{
+    if (graphPanel != nullptr)
+        graphPanel->connectionLayer.repaintConnection (this);
 }
 
 bool GraphPanel::Connection::hitTest (int x, int y)
@@ -214,6 +246,158 @@ Point<int> GraphPanel::Connection::getPinCentreInGraph (const Pin* p)
 
 //==============================================================================
 
+GraphPanel::ConnectionLayer::ConnectionLayer (GraphPanel& panel) : graphPanel (panel), grid (100)
+{
+    setInterceptsMouseClicks (true, false);
+}
+
+void GraphPanel::ConnectionLayer::addConnection (Connection* connection)
+{
+    connection->updatePath();
+    grid.insertOrUpdate (connection, connection->getPathBounds());
+    paintOrder.set (connection, nextPaintOrder++);
+    repaint (connection->getPathBounds());
+}
+
+void GraphPanel::ConnectionLayer::removeConnection (Connection* connection)
+{
+    if (! grid.contains (connection))
+        return;
+    
+    repaint (grid.getIndexedBounds (connection));
+    grid.remove (connection);
+    paintOrder.remove (connection);
+    
+    if (hoveredConnection == connection)
+        hoveredConnection = nullptr;
+    
+    if (mouseDownConnection == connection)
+        mouseDownConnection = nullptr;
+}
+
+void GraphPanel::ConnectionLayer::clear()
+{
+    grid.clear();
+    paintOrder.clear();
+    hoveredConnection = nullptr;
+    mouseDownConnection = nullptr;
+    repaint();
+}
+
+void GraphPanel::ConnectionLayer::connectionsReordered()
+{
+    nextPaintOrder = 0;
+    
+    for (auto connection : graphPanel.connections)
+        if (paintOrder.contains (connection))
+            paintOrder.set (connection, nextPaintOrder++);
+    
+    repaint();
+}
+
+void GraphPanel::ConnectionLayer::connectionMoved (Connection* connection)
+{
+    if (! grid.contains (connection))
+        return;
+    
+    const auto oldBounds = grid.getIndexedBounds (connection);
+    
+    if (! connection->updatePath())
+        return;
+    
+    grid.insertOrUpdate (connection, connection->getPathBounds());
+    
+    if (! repaintsSuspended)
+        repaint (oldBounds.getUnion (connection->getPathBounds()));
+}
+
+void GraphPanel::ConnectionLayer::repaintConnection (Connection* connection)
+{
+    if (grid.contains (connection))
+        repaint (grid.getIndexedBounds (connection));
+}
+
+GraphPanel::Connection* GraphPanel::ConnectionLayer::findConnectionAt (Point<int> point) const
+{
+    auto candidates = grid.findItemsAt (point);
+    
+    // Connections are painted in the order of the panel's array, the last one on top
+    struct PaintOrderComparator
+    {
+        PaintOrderComparator (const HashMap<Connection*, int>& o) : order (o) {}
+        
+        int compareElements (Connection* first, Connection* second) const
+        {
+            return order[first] - order[second];
+        }
+        
+        const HashMap<Connection*, int>& order;
+    };
+    
+    PaintOrderComparator comparator (paintOrder);
+    candidates.sort (comparator);
+    
+    for (int i = candidates.size(); --i >= 0;)
+        if (candidates.getUnchecked (i)->hitTest (point.x, point.y))
+            return candidates.getUnchecked (i);
+    
+    return nullptr;
+}
+
+void GraphPanel::ConnectionLayer::paint (Graphics& g)
+{
+    for (auto connection : graphPanel.connections)
+        if (g.clipRegionIntersects (connection->getPathBounds()))
+            connection->paintConnection (g);
+}
+
+bool GraphPanel::ConnectionLayer::hitTest (int x, int y)
+{
+    return findConnectionAt (Point<int> (x, y)) != nullptr;
+}
+
+void GraphPanel::ConnectionLayer::mouseMove (const MouseEvent& e)
+{
+    setHoveredConnection (findConnectionAt (e.getPosition()));
+}
+
+void GraphPanel::ConnectionLayer::mouseExit (const MouseEvent& e)
+{
+    setHoveredConnection (nullptr);
+}
+
+void GraphPanel::ConnectionLayer::mouseDown (const MouseEvent& e)
+{
+    mouseDownConnection = findConnectionAt (e.getPosition());
+    
+    if (mouseDownConnection != nullptr)
+        mouseDownConnection->mouseDown (e);
+}
+
+void GraphPanel::ConnectionLayer::mouseUp (const MouseEvent& e)
+{
+    if (mouseDownConnection != nullptr)
+        mouseDownConnection->mouseUp (e);
+    
+    mouseDownConnection = nullptr;
+}
+
+void GraphPanel::ConnectionLayer::setHoveredConnection (Connection* connection)
+{
+    if (hoveredConnection == connection)
+        return;
+    
+    if (hoveredConnection != nullptr)
+        hoveredConnection->setHighlighted (false);
+    
+    hoveredConnection = connection;
+    
+    if (hoveredConnection != nullptr)
+        hoveredConnection->setHighlighted (true);
+}
+
+//==============================================================================
+
 GraphPanel::TemporaryConnection::TemporaryConnection (GraphPanel* panel, GraphEmbeddedComponent::Pin* pin, Point<int> point, bool pinToPoint)
 :   fromPinToPoint (pinToPoint)
 {
@@ -267,6 +451,7 @@ int GraphPanel::addComponent (GraphEmbeddedComponent* comp, int x, int y)
 {
     comp->setGraphId (++lastIdGiven);
     comp->setParentGraph (this);
+    indexGraphId (comp, comp->getGraphId());
     comp->setTopLeftPosition (x, y);
     comp->setSelector (&selector);
     comp->setPositionOnLastMouseDown (Point<int> (x, y));
@@ -274,11 +459,13 @@ int GraphPanel::addComponent (GraphEmbeddedComponent* comp, int x, int y)
     addAndMakeVisible (comp);
     
     embeddedComponents.addIfNotAlreadyThere (comp);
+    spatialIndex.insertOrUpdate (comp);
+    embeddedComponentAdded (comp);
     
     moveToFront (comp, true);
     
     adaptSizeToContent();
-    graphContentChanged();
+    contentChanged();
         
     return lastIdGiven;
 }
@@ -290,10 +477,13 @@ bool GraphPanel::removeComponent (GraphEmbeddedComponent* comp, bool undoable)
         disconnect (comp, undoable);
         
         removeChildComponent (comp);
+        unindexGraphId (comp, comp->getGraphId());
         embeddedComponents.removeObject (comp);
+        spatialIndex.remove (comp);
+        embeddedComponentRemoved (comp);
        
         adaptSizeToContent (false);
-        graphContentChanged();
+        contentChanged();
         
         comp->setParentGraph (nullptr);
         comp->wasRemovedFromGraph();
@@ -334,14 +524,13 @@ bool GraphPanel::createConnectionBetween (Pin* source, Pin* dest, bool undoable)
     
     Connection* newConnection = createConnectionObject (this, source, dest);
     connections.add (newConnection);
-    addAndMakeVisible (newConnection);
+    indexConnection (newConnection);
+    connectionLayer.addConnection (newConnection);
     newConnection->setSelector (&selector);
     
     source->incNumConnections();
     dest->incNumConnections();
     
-    resized();
-    
     source->owner.wasConnected();
     dest->owner.wasConnected();
     
@@ -355,14 +544,15 @@ bool GraphPanel::removeConnectionBetween (Pin* source, Pin* dest, bool undoable)
     
     Connection* connectionToRemove = nullptr;
     
-    for (auto connection : connections)
+    for (auto connection : getConnectionsForPin (source))
         if (connection->getSourcePin() == source && connection->getDestinationPin() == dest)
             connectionToRemove = connection;
     
     if (connectionToRemove == nullptr)
         return false;
     
-    removeChildComponent (connectionToRemove);
+    unindexConnection (connectionToRemove);
+    connectionLayer.removeConnection (connectionToRemove);
     connections.removeObject (connectionToRemove);
     
     source->decNumConnections();
@@ -379,18 +569,74 @@ bool GraphPanel::disconnect (GraphEmbeddedComponent* comp, bool undoable)
     if (comp == nullptr)
         return false;
     
-    for (int i = connections.size(); --i >= 0;)
+    // Work on a copy as the index is modified by each removal
+    const Array<Connection*> compConnections (getConnectionsForComponent (comp));
+    
+    for (int i = compConnections.size(); --i >= 0;)
     {
-        Pin* sourcePin = connections.getUnchecked(i)->getSourcePin();
-        Pin* destPin = connections.getUnchecked(i)->getDestinationPin();
+        Pin* sourcePin = compConnections.getUnchecked(i)->getSourcePin();
+        Pin* destPin = compConnections.getUnchecked(i)->getDestinationPin();
         
-        if (sourcePin->getOwnerComponent() == comp || destPin->getOwnerComponent() == comp)
-            removeConnectionBetween (sourcePin, destPin, undoable);
+        removeConnectionBetween (sourcePin, destPin, undoable);
     }
     
     return false;
 }
 
+const Array<Connection*>& GraphPanel::getConnectionsForPin (const Pin* pin) const
+{
+    return HashMapHelpers::find (connectionsForPin, pin);
+}
+
+const Array<Connection*>& GraphPanel::getConnectionsForComponent (const GraphEmbeddedComponent* comp) const
+{
+    return HashMapHelpers::find (connectionsForComponent, comp);
+}
+
+void GraphPanel::indexConnection (Connection* connection)
+{
+    auto source = connection->getSourcePin();
+    auto dest = connection->getDestinationPin();
+    
+    connectionsForPin.getReference (source).addIfNotAlreadyThere (connection);
+    connectionsForPin.getReference (dest).addIfNotAlreadyThere (connection);
+    
+    connectionsForComponent.getReference (source->getOwnerComponent()).addIfNotAlreadyThere (connection);
+    connectionsForComponent.getReference (dest->getOwnerComponent()).addIfNotAlreadyThere (connection);
+}
+
+void GraphPanel::unindexConnection (Connection* connection)
+{
+    auto removeFrom = [connection] (auto& map, auto key)
+    {
+        if (! map.contains (key))
+            return;
+        
+        auto& list = map.getReference (key);
+        list.removeAllInstancesOf (connection);
+        
+        if (list.isEmpty())
+            map.remove (key);
+    };
+    
+    auto source = connection->getSourcePin();
+    auto dest = connection->getDestinationPin();
+    
+    removeFrom (connectionsForPin, static_cast<const Pin*> (source));
+    removeFrom (connectionsForPin, static_cast<const Pin*> (dest));
+    removeFrom (connectionsForComponent, static_cast<const GraphEmbeddedComponent*> (source->getOwnerComponent()));
+    removeFrom (connectionsForComponent, static_cast<const GraphEmbeddedComponent*> (dest->getOwnerComponent()));
+}
+
+void GraphPanel::rebuildConnectionIndex()
+{
+    connectionsForPin.clear();
+    connectionsForComponent.clear();
+    
+    for (auto connection : connections)
+        indexConnection (connection);
+}
+
 void GraphPanel::moveToFront (GraphEmbeddedComponent* comp, bool useZ)
 {
     if (comp == nullptr)
@@ -402,6 +648,12 @@ void GraphPanel::moveToFront (GraphEmbeddedComponent* comp, bool useZ)
         return;
     }
     
+    if (isInBulkUpdate())
+    {
+        zOrderNeedsUpdate = true;
+        return;
+    }
+    
     auto sortedComps = sortWithZ (false);
     
     bool compWasMoved = false;
@@ -419,8 +671,7 @@ void GraphPanel::moveToFront (GraphEmbeddedComponent* comp, bool useZ)
         
         if (! connectionsSorted && other->getZ() < connectionsZ)
         {
-            for (auto c : connections)
-                c->toBack();
+            connectionLayer.toBack();
             
             connectionsSorted = true;
         }
@@ -432,8 +683,7 @@ void GraphPanel::moveToFront (GraphEmbeddedComponent* comp, bool useZ)
         comp->toBack();
     
     if (! connectionsSorted)
-        for (auto c : connections)
-            c->toBack();
+        connectionLayer.toBack();
 }
 
 ReferenceCountedArray<GraphEmbeddedComponent> GraphPanel::sortWithZ (bool alsoArrangeComponents)
@@ -463,18 +713,21 @@ ReferenceCountedArray<GraphEmbeddedComponent> GraphPanel::sortWithZ (bool alsoAr
     Comparator comparator;
     comps.sort (comparator);
     
-    if (alsoArrangeComponents)
+    if (alsoArrangeComponents && isInBulkUpdate())
+    {
+        zOrderNeedsUpdate = true;
+    }
+    else if (alsoArrangeComponents)
     {
         bool connectionsSorted = false;
         
-        for (int i = embeddedComponents.size(); --i >= 0;)
+        for (int i = comps.size(); --i >= 0;)
         {
-            auto comp = embeddedComponents.getUnchecked(i);
+            auto comp = comps.getUnchecked(i);
             
             if (! connectionsSorted && comp->getZ() < connectionsZ)
             {
-                for (auto c : connections)
-                    c->toBack();
+                connectionLayer.toBack();
                 
                 connectionsSorted = true;
             }
@@ -483,8 +736,7 @@ ReferenceCountedArray<GraphEmbeddedComponent> GraphPanel::sortWithZ (bool alsoAr
         }
         
         if (! connectionsSorted)
-            for (auto c : connections)
-                c->toBack();
+            connectionLayer.toBack();
     }
     
     return comps;
@@ -494,11 +746,77 @@ void GraphPanel::setZForConnections (int newZ)
 {
     connectionsZ = newZ;
 }
+
+//==============================================================================
+GraphPanel::BulkUpdate::BulkUpdate (GraphPanel& panel) : graphPanel (&panel)
+{
+    ++panel.bulkUpdateDepth;
+}
+
+GraphPanel::BulkUpdate::~BulkUpdate()
+{
+    if (graphPanel != nullptr)
+        graphPanel->endBulkUpdate();
+}
+
+void GraphPanel::endBulkUpdate()
+{
+    jassert (bulkUpdateDepth > 0);
+    
+    if (--bulkUpdateDepth > 0)
+        return;
+    
+    if (zOrderNeedsUpdate)
+    {
+        zOrderNeedsUpdate = false;
+        sortWithZ (true);
+    }
+    
+    if (sizeNeedsUpdate)
+    {
+        sizeNeedsUpdate = false;
+        adaptSizeToContent();
+    }
+    
+    if (contentNeedsUpdate)
+    {
+        contentNeedsUpdate = false;
+        graphContentChanged();
+    }
+    
+    if (selectionNeedsUpdate)
+    {
+        selectionNeedsUpdate = false;
+        selectionChanged();
+    }
+}
+
+void GraphPanel::contentChanged()
+{
+    if (isInBulkUpdate())
+        contentNeedsUpdate = true;
+    else
+        graphContentChanged();
+}
+
+void GraphPanel::selectionChanged()
+{
+    if (isInBulkUpdate())
+    {
+        selectionNeedsUpdate = true;
+        return;
+    }
+    
+    for (auto l : listeners)
+        l->graphSelectionChanged();
+}
 //==============================================================================
 
-GraphPanel::GraphPanel() : selector (*this)
+GraphPanel::GraphPanel() : selector (*this), connectionLayer (*this)
 {
+    addAndMakeVisible (connectionLayer);
     prepareCommandTarget();
+    setUndoMemoryBudget (16 * 1024 * 1024);
 }
 
 GraphPanel::~GraphPanel()
@@ -511,12 +829,17 @@ void GraphPanel::resized()
     if (tempConnection != nullptr)
         tempConnection->setBounds(getLocalBounds());
     
-    for (auto& connection : connections)
-        connection->setBounds(getLocalBounds());
+    connectionLayer.setBounds (getLocalBounds());
 }
 
 void GraphPanel::adaptSizeToContent (bool stretchOnly)
 {
+    if (isInBulkUpdate())
+    {
+        sizeNeedsUpdate = true;
+        return;
+    }
+    
     const int lastCompMargin = 40;
     int contentWidth = 0;
     int contentHeight = 0;
@@ -601,8 +924,15 @@ void GraphPanel::endLasso()
 void GraphPanel::clear()
 {
     removeAllChildren();
+    connectionLayer.clear();
+    addAndMakeVisible (connectionLayer);
+    connectionsForPin.clear();
+    connectionsForComponent.clear();
     connections.clear();
     embeddedComponents.clear();
+    spatialIndex.clear();
+    componentsWithGraphId.clear();
+    graphCleared();
 }
 
 void GraphPanel::startTemporaryConnection (GraphEmbeddedComponent::Pin* starterPin)
@@ -684,24 +1014,53 @@ void GraphPanel::setHighlighted (GraphEmbeddedComponent* compToHighlight)
         comp->setHighlighted (comp == compToHighlight);
 }
 
+void GraphPanel::embeddedBoundsChanged (GraphEmbeddedComponent* comp)
+{
+    // Components are indexed by addComponent, this only follows the ones already there
+    if (spatialIndex.contains (comp))
+        spatialIndex.insertOrUpdate (comp);
+}
+
+void GraphPanel::beginDirtyRegionUpdate()
+{
+    connectionLayer.setRepaintsSuspended (true);
+}
+
+void GraphPanel::endDirtyRegionUpdate (const RectangleList<int>& dirtyRegion)
+{
+    connectionLayer.setRepaintsSuspended (false);
+    
+    int64 area = 0;
+    
+    for (auto& r : dirtyRegion)
+    {
+        repaint (r);
+        area += (int64) r.getWidth() * r.getHeight();
+    }
+    
+    repaintCounter.lastFrameArea = area;
+    repaintCounter.totalArea += area;
+    ++repaintCounter.numFrames;
+}
+
 GraphEmbeddedComponent::Pin* GraphPanel::lookForPinAt (Point<int> p)
 {
-    for (auto comp : embeddedComponents)
-        if (comp->getBounds().contains (p))
-            for (auto placement : comp->getAllPlacements())
-                for (auto pin : comp->getPins (placement))
-                    if (pin->isEnabled() && getRelativeBoundsForPin (pin).contains(p))
-                        return pin;
+    const auto comps = spatialIndex.findComponentsAt (p);
+    
+    // Top-most component first
+    for (int i = comps.size(); --i >= 0;)
+        for (auto placement : comps.getUnchecked (i)->getAllPlacements())
+            for (auto pin : comps.getUnchecked (i)->getPins (placement))
+                if (pin->isEnabled() && getRelativeBoundsForPin (pin).contains(p))
+                    return pin;
     
     return nullptr;
 }
 
 GraphEmbeddedComponent::Pin* GraphPanel::lookForPinWithIds (int graphId, int channelId, Pin::Placement placementToLookFor)
 {
-    for (auto comp : embeddedComponents)
-        if (comp->getGraphId() == graphId)
-            if (auto pin = comp->getPins (placementToLookFor)[channelId])
-                return pin;
+    if (auto comp = findComponentWithGraphId (graphId))
+        return comp->getPins (placementToLookFor)[channelId];
     
     return nullptr;
 }
@@ -729,11 +1088,21 @@ void GraphPanel::sortConnections()
     
     ConnectionComparator comparator;
     connections.sort (comparator);
+    connectionLayer.connectionsReordered();
+    
+    // Keeps per-pin ordering consistent with the sorted array
+    rebuildConnectionIndex();
 }
 
 bool GraphPanel::areAlreadyConnectedTogether (Pin* one, Pin* another) const
 {
-    for (auto connection : connections)
+    if (one == nullptr || another == nullptr)
+        return false;
+    
+    const auto& oneConnections = getConnectionsForPin (one);
+    const auto& anotherConnections = getConnectionsForPin (another);
+    
+    for (auto connection : (oneConnections.size() <= anotherConnections.size() ? oneConnections : anotherConnections))
     {
         if (connection->getSourcePin() == one)
             if (connection->getDestinationPin() == another)
@@ -777,17 +1146,20 @@ Array<ConnectionInfo> GraphPanel::getAllConnections (const GraphEmbeddedComponen
     
     const OwnedArray<Pin>& pins = comp->getPins(placement);
     
+    if (! connectionsForComponent.contains (comp))
+        return result;
+    
     if (placement == Placement::PinOnBottom || placement == Placement::PinOnRight)
     {
         for (auto pin : pins)
-            for (auto connection : connections)
+            for (auto connection : getConnectionsForPin (pin))
                 if (connection->getSourcePin() == pin)
                     result.add (connection->getInfo());
     }
     else
     {
         for (auto pin : pins)
-            for (auto connection : connections)
+            for (auto connection : getConnectionsForPin (pin))
                 if (connection->getDestinationPin() == pin)
                     result.add (connection->getInfo());
     }
@@ -905,6 +1277,8 @@ void GraphPanel::paste()
 
 void GraphPanel::pasteAndAddOffset (const String& xmlDoc, Point<int> offset)
 {
+    const BulkUpdate bulkUpdate (*this);
+    
     Array<ConnectionInfo> info;
     auto pasted = pasteInternal (xmlDoc, true, info);
     
@@ -917,6 +1291,8 @@ void GraphPanel::pasteAtMousePos()
     const String clipboardContent (clipboard->getClipboard());
     const Point<int> mousePos = getMouseXYRelative();
     
+    const BulkUpdate bulkUpdate (*this);
+    
     Array<ConnectionInfo> info;
     auto pasted = pasteInternal (clipboardContent, true, info);
     
@@ -945,18 +1321,23 @@ Array<GraphEmbeddedComponent*> GraphPanel::pasteInternal (const String& xmlDoc,
     
     Array<GraphEmbeddedComponent*> pastedComps;
     
-    Array<std::pair<int, int>> idRemappers;
+    HashMap<int, int> idRemappers;
     
     if (! elem->hasTagName (getClipboardTagName()))
         return pastedComps;
     
+    const BulkUpdate bulkUpdate (*this);
+    
     forEachXmlChildElementWithTagName(*(elem.get()), e, "Embedded")
     {
         if (auto comp = dynamic_cast<GraphEmbeddedComponent*>(createFromXml (*e, undoable)))
         {
             comp->setGraphId (++lastIdGiven);
             pastedComps.add (comp);
-            idRemappers.addIfNotAlreadyThere (std::pair<int, int> (e->getIntAttribute("graphId"), comp->getGraphId()));
+            const int originalId = e->getIntAttribute ("graphId");
+            
+            if (! idRemappers.contains (originalId))
+                idRemappers.set (originalId, comp->getGraphId());
         }
     }
     
@@ -969,11 +1350,7 @@ Array<GraphEmbeddedComponent*> GraphPanel::pasteInternal (const String& xmlDoc,
         
         auto getMappedId = [&](int originalId)
         {
-            for (auto m : idRemappers)
-                if (m.first == originalId)
-                    return m.second;
-            
-            return -1;
+            return idRemappers.contains (originalId) ? idRemappers[originalId] : -1;
         };
         
         forEachXmlChildElementWithTagName(*(elem->getChildByName("CONNECTIONS")), e, "Connection")
@@ -1144,11 +1521,44 @@ bool GraphPanel::perform (const InvocationInfo& info)
 
 GraphEmbeddedComponent* GraphPanel::findComponentWithGraphId (int graphId)
 {
-    for (auto emb : embeddedComponents)
-        if (emb->getGraphId() == graphId)
-            return emb;
+    return HashMapHelpers::find (componentsWithGraphId, graphId).getFirst();
+}
+
+void GraphPanel::graphIdChanged (GraphEmbeddedComponent* comp, int previousId)
+{
+    // Components are indexed by addComponent, this only follows the ones already there
+    if (! HashMapHelpers::find (componentsWithGraphId, previousId).contains (comp))
+        return;
     
-    return nullptr;
+    unindexGraphId (comp, previousId);
+    indexGraphId (comp, comp->getGraphId());
+}
+
+void GraphPanel::indexGraphId (GraphEmbeddedComponent* comp, int graphId)
+{
+    componentsWithGraphId.getReference (graphId).addIfNotAlreadyThere (comp);
+}
+
+void GraphPanel::unindexGraphId (GraphEmbeddedComponent* comp, int graphId)
+{
+    if (! componentsWithGraphId.contains (graphId))
+        return;
+    
+    auto& comps = componentsWithGraphId.getReference (graphId);
+    comps.removeFirstMatchingValue (comp);
+    
+    if (comps.isEmpty())
+        componentsWithGraphId.remove (graphId);
+}
+
+void GraphPanel::setUndoMemoryBudget (int maxBytes, int minTransactionsToKeep)
+{
+    undoManager.setMaxNumberOfStoredUnits (maxBytes, minTransactionsToKeep);
+}
+
+void GraphPanel::beginCoalescedTransaction (const String& transactionName, uint32 coalescingDelayMs)
+{
+    coalescedTransactions.begin (undoManager, transactionName, coalescingDelayMs);
 }
 
 void GraphPanel::refreshGraphIds()
@@ -1202,6 +1612,8 @@ XmlElement* GraphPanel::getStateAsXml()
 
 void GraphPanel::loadStateFromXml (const XmlElement& xml)
 {
+    const BulkUpdate bulkUpdate (*this);
+    
     clear();
     
     forEachXmlChildElementWithTagName (xml, e, "Embedded")
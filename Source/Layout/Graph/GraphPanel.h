@@ -12,6 +12,8 @@
 
 
 #include "GraphEmbeddedComponent.h"
+#include "GraphSpatialIndex.h"
+#include "CoalescedTransactions.h"
 
 struct ConnectionInfo;
 
@@ -40,13 +42,33 @@ public:
     
     //==============================================================================
     GraphSelector& getSelector() { return selector; }
-    void selectionChanged() { for (auto l : listeners) l->graphSelectionChanged(); }
+    void selectionChanged();
     
     //==============================================================================
     const ReferenceCountedArray<GraphEmbeddedComponent>& getEmbeddedComponents() const { return embeddedComponents; }
     Array<WeakReference<GraphEmbeddedComponent>> getAllConnected (const GraphEmbeddedComponent* comp, Pin::Placement placement) const;
     Array<ConnectionInfo> getAllConnections (const GraphEmbeddedComponent* comp, Pin::Placement placement) const;
     
+    const GraphSpatialIndex& getSpatialIndex() const { return spatialIndex; }
+    void embeddedBoundsChanged (GraphEmbeddedComponent* comp);
+    virtual void graphIdChanged (GraphEmbeddedComponent* comp, int previousId);
+    
+    //==============================================================================
+    /** \brief Counts the area invalidated by dirty-region updates, on top of the moved components' own repaints. */
+    struct RepaintCounter
+    {
+        int64 lastFrameArea = 0;
+        int64 totalArea = 0;
+        int numFrames = 0;
+    };
+    
+    /** \brief Stops the connections from repainting themselves until endDirtyRegionUpdate() is called. */
+    void beginDirtyRegionUpdate();
+    /** \brief Repaints the region collected since beginDirtyRegionUpdate() and counts its area. */
+    void endDirtyRegionUpdate (const RectangleList<int>& dirtyRegion);
+    const RepaintCounter& getRepaintCounter() const { return repaintCounter; }
+    void resetRepaintCounter() { repaintCounter = RepaintCounter(); }
+    
     //==============================================================================
     void clear();
     
@@ -65,6 +87,29 @@ public:
     
     //==============================================================================
     virtual void graphContentChanged() {}
+    virtual void embeddedComponentAdded (GraphEmbeddedComponent* comp) {}
+    virtual void embeddedComponentRemoved (GraphEmbeddedComponent* comp) {}
+    virtual void graphCleared() {}
+    
+    //==============================================================================
+    /** \brief Defers layout and content notifications while many elements are added or removed.
+     *
+     *  While a BulkUpdate is alive, adaptSizeToContent(), z-ordering, graphContentChanged() and the
+     *  listeners' callbacks are only recorded. They run once when the outermost BulkUpdate is destroyed.
+     */
+    class BulkUpdate
+    {
+    public:
+        BulkUpdate (GraphPanel& panel);
+        ~BulkUpdate();
+        
+    private:
+        WeakReference<GraphPanel> graphPanel;
+        
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BulkUpdate)
+    };
+    
+    bool isInBulkUpdate() const { return bulkUpdateDepth > 0; }
     
     //==============================================================================
     void moveToFront (GraphEmbeddedComponent* comp, bool useZ = true);    
@@ -84,20 +129,27 @@ public:
         Pin* getSourcePin() const { return sourcePin; }
         Pin* getDestinationPin() const { return destPin; }
         ConnectionInfo getInfo();
-       
-        void paint (Graphics &g) override;
         
+        /** \brief Recomputes the cached paths if the pins have moved. Returns true if the path changed. */
+        bool updatePath();
+        /** \brief Draws the cached path. */
+        void paintConnection (Graphics& g) const;
+        /** \brief The area covered by the cached hit path, in the GraphPanel's coordinates. */
+        juce::Rectangle<int> getPathBounds() const { return pathBounds; }
+        
+        static Path createConnectionPath (Point<float> from, Point<float> to, Pin::Placement sourcePlacement, Pin::Placement destPlacement);
         static Path drawConnection (Point<float> from, Point<float> to, int stroke, Colour colour, Pin::Placement sourcePlacement, Pin::Placement destPlacement, Graphics &g);
         static Path drawTemporaryConnection (Point<float> from, Point<float> to, int stroke, Colour colour, Pin::Placement sourcePlacement, Graphics &g);
         
         void graphEmbeddedChanged() override;
         bool hitTest (int x, int y) override;
         void deleteSelectedItem() override;
+        void appearanceChanged() override;
         
         void setValid (bool shouldBeValid)
         {
             isValid = shouldBeValid;
-            repaint();
+            appearanceChanged();
         }
         
     private:
@@ -110,7 +162,11 @@ public:
         
         Pin* sourcePin;
         Pin* destPin;
+        Path path;
         Path hitPath;
+        juce::Rectangle<int> pathBounds;
+        Point<int> lastSourceCentre, lastDestCentre;
+        bool pathIsValid = false;
         WeakReference<GraphPanel> graphPanel;
         bool isValid = true;
         
@@ -124,9 +180,66 @@ public:
     
     virtual Connection* createConnectionObject (GraphPanel* panel, Pin* source, Pin* dest);
     
+    //==============================================================================
+    /** \brief A single component that draws and hit-tests all the connections of a GraphPanel.
+     *
+     *  Connections are not added as child components : they're painted from their cached paths, and found
+     *  under the mouse with a grid of their bounds.
+     */
+    class ConnectionLayer : public Component
+    {
+    public:
+        ConnectionLayer (GraphPanel& panel);
+        
+        void addConnection (Connection* connection);
+        void removeConnection (Connection* connection);
+        void clear();
+        
+        /** \brief Must be called when the panel's connections array was sorted. */
+        void connectionsReordered();
+        
+        /** \brief Recomputes the path of a connection whose pins may have moved, and repaints the area it covers. */
+        void connectionMoved (Connection* connection);
+        /** \brief Repaints the area covered by a connection. */
+        void repaintConnection (Connection* connection);
+        /** \brief While suspended, moved connections update their path but leave the repaint to the caller. */
+        void setRepaintsSuspended (bool shouldBeSuspended) { repaintsSuspended = shouldBeSuspended; }
+        
+        /** \brief Returns the top-most connection under a point, or nullptr. */
+        Connection* findConnectionAt (Point<int> point) const;
+        
+        void paint (Graphics& g) override;
+        bool hitTest (int x, int y) override;
+        
+        void mouseMove (const MouseEvent& e) override;
+        void mouseExit (const MouseEvent& e) override;
+        void mouseDown (const MouseEvent& e) override;
+        void mouseUp (const MouseEvent& e) override;
+        
+    private:
+        void setHoveredConnection (Connection* connection);
+        
+        GraphPanel& graphPanel;
+        GraphSpatialGrid<Connection> grid;
+        
+        // Rank of each connection in the panel's array, which keeps its order when connections are removed
+        HashMap<Connection*, int> paintOrder;
+        int nextPaintOrder = 0;
+        
+        WeakReference<Connection> hoveredConnection;
+        WeakReference<Connection> mouseDownConnection;
+        
+        bool repaintsSuspended = false;
+        
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConnectionLayer)
+    };
+    
     //==============================================================================
     void sortConnections();
     OwnedArray<Connection>& getConnections() { return connections; }
+    // References into the index: copy them before adding or removing connections
+    const Array<Connection*>& getConnectionsForPin (const Pin* pin) const;
+    const Array<Connection*>& getConnectionsForComponent (const GraphEmbeddedComponent* comp) const;
     bool areAlreadyConnectedTogether (Pin* one, Pin* another) const;
     
     //==============================================================================
@@ -221,6 +334,14 @@ public:
     
     /* NOTE : There's an undomanager here but it's only used in sub-class for now ! */
     UndoManager& getUndoManager() { return undoManager; }
+    
+    /** \brief Limits the memory held by the undo history. Actions report their size in bytes. */
+    void setUndoMemoryBudget (int maxBytes, int minTransactionsToKeep = 20);
+    
+    /** \brief Starts a new undo transaction, unless the previous one had the same name and was started
+     *  less than coalescingDelayMs ago. Used to gather consecutive edits of the same item.
+     */
+    void beginCoalescedTransaction (const String& transactionName, uint32 coalescingDelayMs = 1500);
 protected:
     void refreshGraphIds();
     GraphEmbeddedComponent* findComponentWithGraphId (int graphId);
@@ -244,9 +365,21 @@ private:
     
     void setHighlighted (GraphEmbeddedComponent* compToHighlight);
     
+    void contentChanged();
+    void endBulkUpdate();
+    
     Pin* lookForPinAt (Point<int> p);
     Pin* lookForPinWithIds (int graphId, int channelId, Pin::Placement placementToLookFor);
 	juce::Rectangle<int> getRelativeBoundsForPin (Pin* p);
+    
+    // Graph id index, kept in sync with the components' ids
+    void indexGraphId (GraphEmbeddedComponent* comp, int graphId);
+    void unindexGraphId (GraphEmbeddedComponent* comp, int graphId);
+    
+    // Adjacency index, kept in sync with the connections array
+    void indexConnection (Connection* connection);
+    void unindexConnection (Connection* connection);
+    void rebuildConnectionIndex();
         
     //==============================================================================
     WeakReference<GraphPanel>::Master masterReference;
@@ -258,15 +391,31 @@ private:
     int numConsecutiveDuplicate = 0;
     int connectionsZ = 0;
     
+    int bulkUpdateDepth = 0;
+    bool sizeNeedsUpdate = false;
+    bool zOrderNeedsUpdate = false;
+    bool contentNeedsUpdate = false;
+    bool selectionNeedsUpdate = false;
+    
     SharedResourcePointer<InternalClipboard> clipboard;
     GraphSelector selector;
     
+    GraphSpatialIndex spatialIndex;
+    
+    // Ids can be shared for a short while (e.g. when pasting), the first component given an id wins
+    HashMap<int, Array<GraphEmbeddedComponent*>> componentsWithGraphId;
+    
     OwnedArray<Connection> connections;
+    ConnectionLayer connectionLayer;
+    RepaintCounter repaintCounter;
+    HashMap<const Pin*, Array<Connection*>> connectionsForPin;
+    HashMap<const GraphEmbeddedComponent*, Array<Connection*>> connectionsForComponent;
     ScopedPointer<TemporaryConnection> tempConnection;
     ScopedPointer<LassoComponent<GraphSelectableItem*>> lasso;
     Array<WeakReference<Listener>> listeners;
     
     UndoManager undoManager;
+    CoalescedTransactions coalescedTransactions;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphPanel)
 };
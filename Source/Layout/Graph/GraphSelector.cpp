@@ -26,7 +26,7 @@ void GraphSelectableItem::setSelected (bool shouldBeSelected)
     if (isCurrentlySelected != shouldBeSelected)
     {
         isCurrentlySelected = shouldBeSelected;
-        repaint();
+        appearanceChanged();
     }
 }
 
@@ -41,20 +41,20 @@ void GraphSelectableItem::setHighlighted (bool shouldBeHighlighted)
     if (isCurrentlyHighlighted != shouldBeHighlighted)
     {
         isCurrentlyHighlighted = shouldBeHighlighted;
-        repaint();
+        appearanceChanged();
     }
 }
 
 void GraphSelectableItem::mouseEnter (const MouseEvent& e)
 {
     isCurrentlyHighlighted = true;
-    repaint();
+    appearanceChanged();
 }
 
 void GraphSelectableItem::mouseExit (const MouseEvent& e)
 {
     isCurrentlyHighlighted = false;
-    repaint();
+    appearanceChanged();
 }
 
 void GraphSelectableItem::mouseDown (const MouseEvent& e)
@@ -154,6 +154,7 @@ bool GraphSelector::deleteSelection()
     
     bool allWereDeleted = true;
     
+    const GraphPanel::BulkUpdate bulkUpdate (graphPanel);
     graphPanel.getUndoManager().beginNewTransaction();
     
     for (int i = selectedItems.getNumSelected(); --i >= 0;)
@@ -176,7 +177,7 @@ bool GraphSelector::deleteSelection()
 
 void GraphSelector::findLassoItemsInArea(Array<GraphSelectableItem*>& itemsFound, const juce::Rectangle<int>& area)
 {
-    for (auto comp : graphPanel.getEmbeddedComponents())
+    for (auto comp : graphPanel.getSpatialIndex().findComponentsIntersecting (area))
         if (!area.getIntersection(comp->getLassoSelectionBounds()).isEmpty() && comp->canBeSelectedWithLasso())
             itemsFound.add (comp);
 }
@@ -208,7 +209,7 @@ void GraphSelector::SelectedSet::itemSelected (GraphSelectableItem* item)
     if (!item->isCurrentlySelected)
     {
         item->isCurrentlySelected = true;
-        item->repaint();
+        item->appearanceChanged();
         
         selector.selectionChanged();
     }
@@ -219,7 +220,7 @@ void GraphSelector::SelectedSet::itemDeselected (GraphSelectableItem* item)
     if (item->isCurrentlySelected)
     {
         item->isCurrentlySelected = false;
-        item->repaint();
+        item->appearanceChanged();
         
         selector.selectionChanged();
     }
@@ -56,6 +56,9 @@ public:
     bool canBeDeleted() const { return thisCanBeDeleted; }
     void setCanBeDeleted (bool canBeDeleted) { thisCanBeDeleted = canBeDeleted; }
     
+    /** \brief Called when the selected or highlighted state changed. Repaints this by default. */
+    virtual void appearanceChanged() { repaint(); }
+    
     /** \brief Allow custom behaviors for lasso selection. */
     virtual juce::Rectangle<int> getLassoSelectionBounds() const { return getBounds(); }
     
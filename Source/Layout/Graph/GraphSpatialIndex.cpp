@@ -0,0 +1,36 @@
+#include "GraphSpatialIndex.h"
+
+#include "GraphEmbeddedComponent.h"
+
+void GraphSpatialIndex::insertOrUpdate (GraphEmbeddedComponent* comp)
+{
+    if (comp != nullptr)
+        grid.insertOrUpdate (comp, comp->getBounds());
+}
+
+Array<GraphEmbeddedComponent*> GraphSpatialIndex::findComponentsAt (Point<int> point) const
+{
+    auto comps = grid.findItemsAt (point);
+    
+    // Few components overlap at a point, their child index gives the order they're painted in
+    struct ZOrderComparator
+    {
+        static int getZOrder (GraphEmbeddedComponent* comp)
+        {
+            if (auto parent = comp->getParentComponent())
+                return parent->getIndexOfChildComponent (comp);
+            
+            return -1;
+        }
+        
+        static int compareElements (GraphEmbeddedComponent* first, GraphEmbeddedComponent* second)
+        {
+            return getZOrder (first) - getZOrder (second);
+        }
+    };
+    
+    ZOrderComparator comparator;
+    comps.sort (comparator);
+    
+    return comps;
+}
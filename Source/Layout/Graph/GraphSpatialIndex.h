@@ -0,0 +1,207 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "HashMapHelpers.h"
+
+class GraphEmbeddedComponent;
+
+/** \brief A uniform grid that stores the bounds of arbitrary items of a GraphPanel.
+ *
+ *  Items are only referenced : the caller is responsible for removing them before they get deleted.
+ **/
+template <class ItemType>
+class GraphSpatialGrid
+{
+public:
+    /** \brief Constructor. */
+    GraphSpatialGrid (int cellSizeToUse = 200) : cellSize (jmax (1, cellSizeToUse)) {}
+    
+    /** \brief Adds an item or updates its bounds if it was already indexed. */
+    void insertOrUpdate (ItemType* item, juce::Rectangle<int> newBounds)
+    {
+        if (item == nullptr)
+            return;
+        
+        if (indexedBounds.contains (item))
+        {
+            const auto oldBounds = indexedBounds[item];
+            
+            if (oldBounds == newBounds)
+                return;
+            
+            if (getCellRange (oldBounds) != getCellRange (newBounds))
+            {
+                removeFromCells (item, oldBounds);
+                addToCells (item, newBounds);
+            }
+        }
+        else
+        {
+            addToCells (item, newBounds);
+        }
+        
+        indexedBounds.set (item, newBounds);
+    }
+    
+    /** \brief Removes an item from the index. */
+    void remove (ItemType* item)
+    {
+        if (! indexedBounds.contains (item))
+            return;
+        
+        removeFromCells (item, indexedBounds[item]);
+        indexedBounds.remove (item);
+    }
+    
+    /** \brief Removes all the items. */
+    void clear()
+    {
+        cells.clear();
+        indexedBounds.clear();
+    }
+    
+    /** \brief Is this item indexed ? */
+    bool contains (ItemType* item) const { return indexedBounds.contains (item); }
+    /** \brief Returns the bounds this item was indexed with. */
+    juce::Rectangle<int> getIndexedBounds (ItemType* item) const { return indexedBounds[item]; }
+    
+    /** \brief Finds all the items whose bounds intersect the area, in no particular order. */
+    Array<ItemType*> findItemsIntersecting (juce::Rectangle<int> area) const
+    {
+        Array<ItemType*> result;
+        const auto range = getCellRange (area);
+        
+        for (int x = range.getX(); x <= range.getRight(); ++x)
+        {
+            for (int y = range.getY(); y <= range.getBottom(); ++y)
+            {
+                for (auto item : getCell (getCellKey (x, y)))
+                {
+                    const auto bounds = indexedBounds[item];
+                    
+                    if (! bounds.intersects (area))
+                        continue;
+                    
+                    // An item is in every cell of its range : only the first cell shared with
+                    // the area reports it, so that no lookup is needed to avoid duplicates
+                    const auto itemRange = getCellRange (bounds);
+                    
+                    if (x == jmax (itemRange.getX(), range.getX()) && y == jmax (itemRange.getY(), range.getY()))
+                        result.add (item);
+                }
+            }
+        }
+        
+        return result;
+    }
+    
+    /** \brief Finds all the items whose bounds contain the point, in no particular order. */
+    Array<ItemType*> findItemsAt (Point<int> point) const
+    {
+        Array<ItemType*> result;
+        
+        for (auto item : getCell (getCellKey (getCellCoordinate (point.x), getCellCoordinate (point.y))))
+            if (indexedBounds[item].contains (point))
+                result.add (item);
+        
+        return result;
+    }
+    
+private:
+    /** \brief Returns the range of cells covered by an area, in cell coordinates (inclusive). */
+    juce::Rectangle<int> getCellRange (juce::Rectangle<int> area) const
+    {
+        const int left = getCellCoordinate (area.getX());
+        const int top = getCellCoordinate (area.getY());
+        const int right = getCellCoordinate (jmax (area.getX(), area.getRight() - 1));
+        const int bottom = getCellCoordinate (jmax (area.getY(), area.getBottom() - 1));
+        
+        return juce::Rectangle<int>::leftTopRightBottom (left, top, right, bottom);
+    }
+    
+    int getCellCoordinate (int position) const
+    {
+        // Rounds towards minus infinity so that negative positions get their own cells
+        return position >= 0 ? position / cellSize : ((position + 1) / cellSize) - 1;
+    }
+    
+    static int64 getCellKey (int cellX, int cellY)
+    {
+        return ((int64) cellX << 32) | (int64) (uint32) cellY;
+    }
+    
+    const Array<ItemType*>& getCell (int64 key) const
+    {
+        return HashMapHelpers::find (cells, key);
+    }
+    
+    void addToCells (ItemType* item, juce::Rectangle<int> bounds)
+    {
+        const auto range = getCellRange (bounds);
+        
+        for (int x = range.getX(); x <= range.getRight(); ++x)
+            for (int y = range.getY(); y <= range.getBottom(); ++y)
+                cells.getReference (getCellKey (x, y)).addIfNotAlreadyThere (item);
+    }
+    
+    void removeFromCells (ItemType* item, juce::Rectangle<int> bounds)
+    {
+        const auto range = getCellRange (bounds);
+        
+        for (int x = range.getX(); x <= range.getRight(); ++x)
+        {
+            for (int y = range.getY(); y <= range.getBottom(); ++y)
+            {
+                const auto key = getCellKey (x, y);
+                
+                if (! cells.contains (key))
+                    continue;
+                
+                auto& cell = cells.getReference (key);
+                cell.removeFirstMatchingValue (item);
+                
+                if (cell.isEmpty())
+                    cells.remove (key);
+            }
+        }
+    }
+    
+    const int cellSize;
+    
+    HashMap<int64, Array<ItemType*>> cells;
+    HashMap<ItemType*, juce::Rectangle<int>> indexedBounds;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphSpatialGrid)
+};
+
+//==============================================================================
+/** \brief A uniform grid that stores the bounds of the GraphEmbeddedComponents of a GraphPanel.
+ *
+ *  Pins lie within their owner's bounds, so looking for components is enough to find pins too.
+ **/
+class GraphSpatialIndex
+{
+public:
+    /** \brief Constructor. */
+    GraphSpatialIndex (int cellSizeToUse = 200) : grid (cellSizeToUse) {}
+    
+    /** \brief Adds a component or updates its bounds if it was already indexed. */
+    void insertOrUpdate (GraphEmbeddedComponent* comp);
+    /** \brief Removes a component from the index. */
+    void remove (GraphEmbeddedComponent* comp) { grid.remove (comp); }
+    /** \brief Removes all the components. */
+    void clear() { grid.clear(); }
+    
+    /** \brief Is this component indexed ? */
+    bool contains (GraphEmbeddedComponent* comp) const { return grid.contains (comp); }
+    
+    /** \brief Finds all the components whose bounds intersect the area, in no particular order. */
+    Array<GraphEmbeddedComponent*> findComponentsIntersecting (juce::Rectangle<int> area) const { return grid.findItemsIntersecting (area); }
+    /** \brief Finds all the components whose bounds contain the point, from back to front. */
+    Array<GraphEmbeddedComponent*> findComponentsAt (Point<int> point) const;
+    
+private:
+    GraphSpatialGrid<GraphEmbeddedComponent> grid;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphSpatialIndex)
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Starts undo transactions for a stream of small edits, such as drags or typing, so that they
+// are undone at once. A new transaction is only started when the last one had another name or
+// is older than the coalescing delay.
+class CoalescedTransactions
+{
+public:
+    // canReuseLast lets the caller refuse the last transaction for reasons of its own
+    void begin (UndoManager& um, const String& transactionName, uint32 coalescingDelayMs, bool canReuseLast = true)
+    {
+        const uint32 now = Time::getMillisecondCounter();
+        
+        // After an undo, the current transaction isn't the last one anymore
+        const bool canCoalesce = canReuseLast
+                              && um.canUndo()
+                              && ! um.canRedo()
+                              && um.getUndoDescription() == transactionName
+                              && now - lastTransactionTime < coalescingDelayMs;
+        
+        if (! canCoalesce)
+            um.beginNewTransaction (transactionName);
+        
+        lastTransactionTime = now;
+    }
+    
+private:
+    uint32 lastTransactionTime = 0;
+};
@@ -551,8 +551,9 @@ void PropertyItem::propertyItemValueChanged (PropertyItemComponent* comp, String
 {
     auto um = propertyTree.getUndoManager();
     
+    // ValueTree merges consecutive changes of the same property within a transaction
     if (um != nullptr)
-        um->beginNewTransaction();
+        propertyTree.beginEditTransaction (*um, tree);
     
     tree.setProperty ("value", newValue, um);
 }
@@ -679,6 +680,14 @@ Colour PropertyTree::getTextColour() const
     return textColour;
 }
 
+void PropertyTree::beginEditTransaction (UndoManager& um, const ValueTree& editedProperty)
+{
+    editTransactions.begin (um, "Edit " + editedProperty["name"].toString(), editCoalescingDelayMs,
+                            editedProperty == lastEditedProperty);
+    
+    lastEditedProperty = editedProperty;
+}
+
 void PropertyTree::saveOpenness (TreeViewItem* item)
 {
     if (auto propItem = dynamic_cast<PropertyItem*>(item))
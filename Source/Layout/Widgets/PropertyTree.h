@@ -11,6 +11,7 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "CoalescedTransactions.h"
 
 //==============================================================================
 struct PropertyValueConstrainer
@@ -465,6 +466,9 @@ public:
     void setUndoManager (UndoManager* um) { undoManager = um; }
     virtual UndoManager* getUndoManager() { return undoManager; }
     
+    // Consecutive edits of the same property, such as typing its value, share one transaction
+    void beginEditTransaction (UndoManager& um, const ValueTree& editedProperty);
+    
     void setIndentSize (int newSize);
     
     void setTextColour (Colour newColour);
@@ -488,5 +492,9 @@ private:
     Colour textColour;
     UndoManager* undoManager = nullptr;
     
+    ValueTree lastEditedProperty;
+    CoalescedTransactions editTransactions;
+    enum { editCoalescingDelayMs = 1500 };
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PropertyTree)
 };
@@ -287,6 +287,10 @@ bool Project::saveProjectConfig (File destination)
     ps.setValue("name", name);
     ps.setValue("created", creationDate);
     ps.setValue("directory", projectDirectory.getFullPathName());
+    transcodeSettings.saveTo (ps);
+    ps.setValue("audioBundle", useAudioBundle);
+    ps.setValue("optimizeGraph", optimizeGraph);
+    ps.setValue("eliminateDeadNodes", eliminateDeadNodes);
     
     // Create the XML element from the property set
     ScopedPointer<XmlElement> element = new XmlElement (projectFileTagName);
@@ -346,6 +350,10 @@ bool Project::loadProjectConfig (const File & file)
     name = ps.getValue ("name");    // Not sure this is even used anymore...
     creationDate = ps.getValue ("created");
     projectDirectory = ps.getValue ("directory");
+    transcodeSettings.loadFrom (ps);
+    useAudioBundle = ps.getBoolValue ("audioBundle", false);
+    optimizeGraph = ps.getBoolValue ("optimizeGraph", false);
+    eliminateDeadNodes = ps.getBoolValue ("eliminateDeadNodes", true);
     
     projectFile = file;
     
@@ -415,6 +423,7 @@ Panel* Project::loadPanelLayout (XmlElement* state)
 #include "AudioFilesPanel.h"
 #include "LibraryPanel.h"
 #include "OutputScriptPanel.h"
+#include "ServerMetricsPanel.h"
 
 Panel* Project::findStaticPanel (XmlElement* state)
 {
@@ -427,6 +436,7 @@ Panel* Project::findStaticPanel (XmlElement* state)
     else if (tag == "OutputScriptPanel")        return findStaticPanelWithClass<OutputScriptPanel>();
     else if (tag == "AudioFilesPanel")          return findStaticPanelWithClass<AudioFilesPanel>();
     else if (tag == "Library")                  return findStaticPanelWithClass<LibraryPanel>();
+    else if (tag == "Server")                   return findStaticPanelWithClass<ServerMetricsPanel>();
     else                                        return nullptr;
 }
 
@@ -463,6 +473,9 @@ void Project::createStaticPanels()
     
     auto lib = new LibraryPanel (*this);
     staticPanels.add (lib);
+    
+    auto serverMetrics = new ServerMetricsPanel (*this);
+    staticPanels.add (serverMetrics);
 }
 
 bool Project::windowContainsAllStaticPanels (PanelWindow* window)
@@ -505,7 +518,9 @@ PanelWindow* Project::openDefaultWindow()
     c->addChildNode (30, 30,30)->setComponent (findStaticPanelWithClass<CodeGenerationPanel>());
     c->addChildNode (-0.4, 100)->setComponent (findStaticPanelWithClass<CodeEditorPanel>());
     
-    panelRoot.addChildNode (-0.2, 100)->setComponent (findStaticPanelWithClass<WebAudioInspector>());
+    auto r = panelRoot.addChildNode (-0.2, 100);
+    r->addChildNode (-0.7, 100)->setComponent (findStaticPanelWithClass<WebAudioInspector>());
+    r->addChildNode (-0.3, 100)->setComponent (findStaticPanelWithClass<ServerMetricsPanel>());
     
     return window;
 }
@@ -12,6 +12,7 @@
 
 #include "NavigationPanel.h"
 #include "ProjectCommandTarget.h"
+#include "AudioTranscoder.h"
 
 class ProjectManager;
 
@@ -94,6 +95,28 @@ public:
      */
     void restoreDefaultPanelLayout();
     
+    //==============================================================================
+    /** \brief Transcoding applied to the audio files when generating the output.
+     *  Saved in the project config.
+     */
+    const AudioTranscoder::Settings& getTranscodeSettings() const { return transcodeSettings; }
+    void setTranscodeSettings (const AudioTranscoder::Settings& newSettings) { transcodeSettings = newSettings; }
+    
+    /** \brief Should the audio files also be packed into a single bundle fetched at once by the page ?
+     */
+    bool isUsingAudioBundle() const { return useAudioBundle; }
+    void setUsingAudioBundle (bool shouldUseBundle) { useAudioBundle = shouldUseBundle; }
+    
+    /** \brief Should the generator remove the nodes that have no effect (see WebAudioGraphOptimizer) ?
+     */
+    bool isOptimizingGraph() const { return optimizeGraph; }
+    void setOptimizingGraph (bool shouldOptimize) { optimizeGraph = shouldOptimize; }
+    
+    /** \brief Should the generator leave out the nodes that can't be heard nor used (see WebAudioGraphGenerator) ?
+     */
+    bool isEliminatingDeadNodes() const { return eliminateDeadNodes; }
+    void setEliminatingDeadNodes (bool shouldEliminate) { eliminateDeadNodes = shouldEliminate; }
+    
 private:
     //To use weak references to this project
     WeakReference<Project>::Master masterReference;
@@ -193,6 +216,10 @@ private:
     String creationDate;
     File projectFile;
     File projectDirectory;
+    AudioTranscoder::Settings transcodeSettings;
+    bool useAudioBundle = false;
+    bool optimizeGraph = false;
+    bool eliminateDeadNodes = true;
     
     OwnedArray<Panel> staticPanels;
     
@@ -0,0 +1,61 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GraphSpatialIndex.h"
+
+class GraphSpatialGridTests  : public UnitTest
+{
+public:
+    GraphSpatialGridTests() : UnitTest ("GraphSpatialGrid", "Layout") {}
+    
+    struct Item {};
+    
+    void runTest() override
+    {
+        Item small, large, negative;
+        GraphSpatialGrid<Item> grid (100);
+        
+        grid.insertOrUpdate (&small, { 10, 10, 20, 20 });
+        grid.insertOrUpdate (&large, { 50, 50, 300, 300 });
+        grid.insertOrUpdate (&negative, { -150, -150, 100, 100 });
+        
+        beginTest ("Items spanning several cells are found once");
+        {
+            const auto found = grid.findItemsIntersecting ({ -1000, -1000, 2000, 2000 });
+            
+            expectEquals (found.size(), 3);
+            expect (found.contains (&small) && found.contains (&large) && found.contains (&negative));
+        }
+        
+        beginTest ("Areas and points only find the items they touch");
+        {
+            expect (grid.findItemsIntersecting ({ 200, 200, 10, 10 }) == Array<Item*> { &large });
+            expect (grid.findItemsIntersecting ({ 400, 400, 10, 10 }).isEmpty());
+            
+            expect (grid.findItemsAt ({ 15, 15 }) == Array<Item*> { &small });
+            expect (grid.findItemsAt ({ -100, -100 }) == Array<Item*> { &negative });
+            
+            // Bounds exclude their right and bottom edges
+            expect (grid.findItemsAt ({ 350, 350 }).isEmpty());
+            expect (grid.findItemsAt ({ 349, 349 }) == Array<Item*> { &large });
+        }
+        
+        beginTest ("Moved and removed items leave their old cells");
+        {
+            grid.insertOrUpdate (&small, { 500, 500, 20, 20 });
+            
+            expect (grid.findItemsAt ({ 15, 15 }).isEmpty());
+            expect (grid.findItemsAt ({ 510, 510 }) == Array<Item*> { &small });
+            expect (grid.getIndexedBounds (&small) == juce::Rectangle<int> (500, 500, 20, 20));
+            
+            grid.remove (&large);
+            
+            expect (! grid.contains (&large));
+            expect (grid.findItemsIntersecting ({ -1000, -1000, 2000, 2000 }).size() == 2);
+            
+            grid.clear();
+            
+            expect (grid.findItemsIntersecting ({ -1000, -1000, 2000, 2000 }).isEmpty());
+        }
+    }
+};
+
+static GraphSpatialGridTests graphSpatialGridTests;
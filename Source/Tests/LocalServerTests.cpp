@@ -0,0 +1,61 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WebServer.h"
+
+class LocalServerTests  : public UnitTest
+{
+public:
+    LocalServerTests() : UnitTest ("LocalServer", "WebServer") {}
+    
+    void expectRange (const String& header, Range<int64> expected)
+    {
+        const auto range = LocalServer::parseByteRange (header, 1000);
+        expect (range == expected, header + " gave " + String (range.getStart()) + "-" + String (range.getEnd()));
+    }
+    
+    void runTest() override
+    {
+        const Range<int64> wholeFile (0, 1000);
+        
+        beginTest ("Byte ranges");
+        {
+            expectRange ("bytes=0-499", { 0, 500 });
+            expectRange ("bytes=500-", { 500, 1000 });
+            expectRange ("bytes=-200", { 800, 1000 });
+            expectRange ("bytes=-5000", wholeFile);
+            expectRange ("bytes=900-5000", { 900, 1000 });
+            expectRange ("BYTES= 10 - 19 ", { 10, 20 });
+        }
+        
+        beginTest ("Unsatisfiable byte ranges are empty");
+        {
+            expect (LocalServer::parseByteRange ("bytes=1000-", 1000).isEmpty());
+            expect (LocalServer::parseByteRange ("bytes=1500-2000", 1000).isEmpty());
+        }
+        
+        beginTest ("Unusable Range headers give the whole file");
+        {
+            expectRange ("bytes=0-1,5-9", wholeFile);
+            expectRange ("items=0-10", wholeFile);
+            expectRange ("bytes=-", wholeFile);
+            expectRange ("bytes=a-b", wholeFile);
+            expectRange ("bytes=12", wholeFile);
+            expectRange ("bytes=500-100", wholeFile);
+        }
+        
+        beginTest ("Entity tags");
+        {
+            const String etag ("\"abc\"");
+            
+            expect (LocalServer::matchesEntityTag ("\"abc\"", etag));
+            expect (LocalServer::matchesEntityTag ("W/\"abc\"", etag));
+            expect (LocalServer::matchesEntityTag ("\"xyz\", \"abc\"", etag));
+            expect (LocalServer::matchesEntityTag ("*", etag));
+            
+            expect (! LocalServer::matchesEntityTag ("\"abcd\"", etag));
+            expect (! LocalServer::matchesEntityTag ("abc", etag));
+            expect (! LocalServer::matchesEntityTag ("\"a,bc\"", "\"a\""));
+        }
+    }
+};
+
+static LocalServerTests localServerTests;
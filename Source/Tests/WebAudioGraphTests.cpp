@@ -0,0 +1,383 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WebAudioGraphModel.h"
+#include "WebAudioGraphOptimizer.h"
+#include "WebAudioGraphCodeGenerator.h"
+#include "WebAudioGraphElementTypeNames.h"
+
+namespace
+{
+    using Element = WebAudioGraphModel::Element;
+    using Connection = WebAudioGraphModel::Connection;
+
+    Element makeNode (int graphId, const String& name, const String& interfaceName,
+                      const StringPairArray& options = StringPairArray())
+    {
+        Element e;
+        e.graphId = graphId;
+        e.type = GraphElementType::audioNodeType;
+        e.name = name;
+        e.interfaceName = interfaceName;
+        e.bounds = { 0, graphId * 100, 150, 60 };
+        e.hasInstance = true;
+        
+        for (auto& key : options.getAllKeys())
+            e.options.add ({ key, options[key] });
+        
+        return e;
+    }
+    
+    Element makeElement (int graphId, const String& type, const String& name, const String& content = String())
+    {
+        Element e;
+        e.graphId = graphId;
+        e.type = type;
+        e.name = name;
+        e.bounds = { 500, graphId * 100, 150, 60 };
+        e.scriptContent = content;
+        return e;
+    }
+    
+    StringPairArray gainOf (const String& value)
+    {
+        StringPairArray options;
+        options.set ("gain", value);
+        return options;
+    }
+    
+    // Output of source to the audio input of dest
+    Connection audio (int sourceId, int destId)
+    {
+        return { sourceId, 0, WebAudioGraphModel::pinOnBottom, destId, 0, WebAudioGraphModel::pinOnTop };
+    }
+    
+    String getOption (const Element& e, const String& name)
+    {
+        for (auto& o : e.options)
+            if (o.name == name)
+                return o.value;
+        
+        return String();
+    }
+    
+    const Element* findElementWithName (const WebAudioGraphModel& model, const String& name)
+    {
+        for (int i = 0; i < model.getNumElements(); ++i)
+            if (model.getElement (i).name == name)
+                return &model.getElement (i);
+        
+        return nullptr;
+    }
+}
+
+//==============================================================================
+class WebAudioGraphModelTests  : public UnitTest
+{
+public:
+    WebAudioGraphModelTests() : UnitTest ("WebAudioGraphModel", "WebAudio") {}
+    
+    void runTest() override
+    {
+        beginTest ("loadFromXml reads the elements, options and connections");
+        {
+            ScopedPointer<XmlElement> xml (XmlDocument::parse (
+                "<GraphPanel>"
+                "  <Embedded graphId='1' elementType='audioContextType' name='ctx2' interface='AudioContext'"
+                "            xpos='0' ypos='0' width='800' height='600'/>"
+                "  <Embedded graphId='2' elementType='audioNodeType' name='osc' interface='OscillatorNode'"
+                "            xpos='100' ypos='100' width='150' height='60'>"
+                "    <OPTIONS type='square' frequency='220'/>"
+                "  </Embedded>"
+                "  <Embedded graphId='3' elementType='audioNodeType' name='outside' interface='GainNode'"
+                "            xpos='1000' ypos='1000' width='150' height='60' contextGraphId='1'>"
+                "    <OPTIONS gain=''/>"
+                "  </Embedded>"
+                "  <Embedded graphId='4' elementType='scriptType' name='play' editorContent='osc.start();'"
+                "            xpos='900' ypos='0' width='100' height='40'/>"
+                "  <Connection sourceId='2' sourceChannel='0' sourcePlacement='2' destId='3' destChannel='0' destPlacement='0'/>"
+                "  <Connection sourceId='2' sourceChannel='0' sourcePlacement='2' destId='42' destChannel='0' destPlacement='0'/>"
+                "</GraphPanel>"));
+            
+            WebAudioGraphModel model;
+            expect (xml != nullptr && model.loadFromXml (*xml));
+            expectEquals (model.getNumElements(), 4);
+            
+            auto osc = model.findElementWithGraphId (2);
+            expect (osc != nullptr && osc->isNode() && osc->hasInstance);
+            expectEquals (osc->interfaceName, String ("OscillatorNode"));
+            expectEquals (getOption (*osc, "type"), String ("square"));
+            expectEquals (getOption (*osc, "frequency"), String ("220"));
+            
+            // Containment comes from the bounds, a saved context the node has left is dropped
+            expectEquals (osc->contextId, 1);
+            expectEquals (model.findElementWithGraphId (3)->contextId, -1);
+            
+            expect (model.findElementWithGraphId (4)->isScript());
+            expect (! model.findElementWithGraphId (4)->hasInstance);
+            expectEquals (model.findElementWithGraphId (4)->scriptContent, String ("osc.start();"));
+            
+            // The connection to a missing element is dropped
+            expectEquals (model.getConnections().size(), 1);
+            expect (model.getConnections().getFirst() == audio (2, 3));
+        }
+        
+        beginTest ("Container and connection queries use the model's indices");
+        {
+            WebAudioGraphModel model;
+            
+            auto ctx = makeNode (1, "ctx2", "AudioContext");
+            ctx.type = GraphElementType::audioContextType;
+            model.addElement (ctx);
+            
+            auto route = makeNode (2, "route", "");
+            route.type = GraphElementType::dynamicRouteType;
+            model.addElement (route);
+            
+            auto osc = makeNode (3, "osc", "OscillatorNode");
+            osc.contextId = 1;
+            osc.dynamicRouteIds.add (2);
+            model.addElement (osc);
+            
+            model.addElement (makeNode (4, "first", "GainNode"));
+            model.addElement (makeNode (5, "second", "GainNode"));
+            
+            expect (model.addConnection (audio (3, 4)));
+            expect (model.addConnection (audio (3, 5)));
+            expect (! model.addConnection (audio (3, 4)), "Duplicates are rejected");
+            
+            expect (model.getAllNodesInContext (1) == Array<const Element*> { model.findElementWithGraphId (3) });
+            expectEquals (model.getAllNodesWithoutContext().size(), 2);
+            expect (model.getAllNodesInDynamicRoute (2) == Array<const Element*> { model.findElementWithGraphId (3) });
+            expect (model.getAllNodesInDynamicRoute (42).isEmpty());
+            
+            const auto oscElement = model.findElementWithGraphId (3);
+            expectEquals (model.getAllConnected (*oscElement, WebAudioGraphModel::pinOnBottom).size(), 2);
+            expect (model.getAllConnected (*oscElement, WebAudioGraphModel::pinOnTop).isEmpty());
+            expect (model.getAllConnected (*model.findElementWithGraphId (5), WebAudioGraphModel::pinOnTop)
+                      == Array<const Element*> { oscElement });
+            
+            model.clear();
+            expect (model.getAllNodesInContext (1).isEmpty());
+        }
+        
+        beginTest ("loadFromXml only accepts a GraphPanel element");
+        {
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "gain", "GainNode"));
+            
+            expect (! model.loadFromXml (XmlElement ("Panels")));
+            expectEquals (model.getNumElements(), 0);
+        }
+    }
+};
+
+static WebAudioGraphModelTests webAudioGraphModelTests;
+
+//==============================================================================
+class DeadNodeEliminationTests  : public UnitTest
+{
+public:
+    DeadNodeEliminationTests() : UnitTest ("Dead node elimination", "WebAudio") {}
+    
+    static bool isDeclared (const WebAudioGraphGenerator& generator, const String& name, const String& interfaceName)
+    {
+        return generator.getGeneratedScript().contains (name + " = new " + interfaceName + "(");
+    }
+    
+    void runTest() override
+    {
+        // osc -> gain -> destination, plus a chain that isn't heard and nodes used otherwise
+        WebAudioGraphModel model;
+        model.addElement (makeNode (1, "osc", "OscillatorNode"));
+        model.addElement (makeNode (2, "gain", "GainNode"));
+        
+        auto destination = makeNode (3, "ctx.destination", "AudioDestinationNode");
+        destination.type = GraphElementType::audioDestinationNodeType;
+        destination.hasInstance = false;
+        model.addElement (destination);
+        
+        model.addElement (makeNode (4, "deadOsc", "OscillatorNode"));
+        model.addElement (makeNode (5, "deadGain", "GainNode"));
+        model.addElement (makeNode (6, "scripted", "GainNode"));
+        model.addElement (makeNode (7, "triggered", "ConstantSourceNode"));
+        model.addElement (makeElement (8, GraphElementType::scriptType, "setup", "scripted.gain.value = 0.5;"));
+        model.addElement (makeElement (9, GraphElementType::messageType, "start"));
+        
+        model.addConnection (audio (1, 2));
+        model.addConnection (audio (2, 3));
+        model.addConnection (audio (4, 5));
+        model.addConnection ({ 9, 0, WebAudioGraphModel::pinOnRight, 7, 0, WebAudioGraphModel::pinOnLeft });
+        
+        WebAudioGraphGenerator generator;
+        
+        beginTest ("findLiveElements keeps what is heard or used");
+        {
+            generator.generate (model);
+            
+            expect (isDeclared (generator, "osc", "OscillatorNode"));
+            expect (isDeclared (generator, "gain", "GainNode"));
+            expect (isDeclared (generator, "scripted", "GainNode"), "Nodes named in the code are kept");
+            expect (isDeclared (generator, "triggered", "ConstantSourceNode"), "Message targets are kept");
+            
+            expect (! isDeclared (generator, "deadOsc", "OscillatorNode"));
+            expect (! isDeclared (generator, "deadGain", "GainNode"));
+        }
+        
+        beginTest ("Nodes after a message target are kept");
+        {
+            // pulse -> pulseGain isn't heard, but the message acts on pulse and so on what it feeds
+            WebAudioGraphModel targeted;
+            targeted.addElement (makeNode (1, "pulse", "OscillatorNode"));
+            targeted.addElement (makeNode (2, "pulseGain", "GainNode"));
+            targeted.addElement (makeNode (3, "unused", "GainNode"));
+            targeted.addElement (makeElement (4, GraphElementType::messageType, "start"));
+            targeted.addConnection (audio (1, 2));
+            targeted.addConnection ({ 4, 0, WebAudioGraphModel::pinOnRight, 1, 0, WebAudioGraphModel::pinOnLeft });
+            
+            generator.generate (targeted);
+            
+            expect (isDeclared (generator, "pulse", "OscillatorNode"));
+            expect (isDeclared (generator, "pulseGain", "GainNode"));
+            expect (! isDeclared (generator, "unused", "GainNode"));
+        }
+        
+        beginTest ("Disabling the elimination keeps every node");
+        {
+            generator.setDeadNodeEliminationEnabled (false);
+            generator.generate (model);
+            
+            expect (isDeclared (generator, "deadOsc", "OscillatorNode"));
+            expect (isDeclared (generator, "deadGain", "GainNode"));
+        }
+    }
+};
+
+static DeadNodeEliminationTests deadNodeEliminationTests;
+
+//==============================================================================
+class WebAudioGraphOptimizerTests  : public UnitTest
+{
+public:
+    WebAudioGraphOptimizerTests() : UnitTest ("WebAudioGraphOptimizer", "WebAudio") {}
+    
+    void runTest() override
+    {
+        beginTest ("Chains of static gains are folded");
+        {
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "osc", "OscillatorNode"));
+            model.addElement (makeNode (2, "first", "GainNode", gainOf ("0.5")));
+            model.addElement (makeNode (3, "second", "GainNode", gainOf ("0.25")));
+            model.addElement (makeNode (4, "out", "AnalyserNode"));
+            model.addConnection (audio (1, 2));
+            model.addConnection (audio (2, 3));
+            model.addConnection (audio (3, 4));
+            
+            WebAudioGraphModel result;
+            WebAudioGraphOptimizer optimizer (model);
+            
+            expectEquals (optimizer.optimize (result), 1);
+            expect (findElementWithName (result, "first") == nullptr);
+            
+            auto second = findElementWithName (result, "second");
+            expect (second != nullptr && getOption (*second, "gain").getDoubleValue() == 0.125);
+            expect (optimizer.getRewrittenIds().contains (3));
+            
+            expect (result.getConnections().contains (audio (1, 3)));
+            expect (result.getConnections().contains (audio (3, 4)));
+        }
+        
+        beginTest ("A gain folded into one without a gain option sets it");
+        {
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "osc", "OscillatorNode"));
+            model.addElement (makeNode (2, "first", "GainNode", gainOf ("0.5")));
+            model.addElement (makeNode (3, "second", "GainNode"));
+            model.addElement (makeNode (4, "out", "AnalyserNode"));
+            model.addConnection (audio (1, 2));
+            model.addConnection (audio (2, 3));
+            model.addConnection (audio (3, 4));
+            
+            WebAudioGraphModel result;
+            expectEquals (WebAudioGraphOptimizer (model).optimize (result), 1);
+            expect (findElementWithName (result, "first") == nullptr);
+            
+            auto second = findElementWithName (result, "second");
+            expect (second != nullptr && getOption (*second, "gain").getDoubleValue() == 0.5);
+            expect (result.getConnections().contains (audio (1, 3)));
+        }
+        
+        beginTest ("Unity gains are bypassed");
+        {
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "osc", "OscillatorNode"));
+            model.addElement (makeNode (2, "unity", "GainNode", gainOf ("1")));
+            model.addElement (makeNode (3, "out", "AnalyserNode"));
+            model.addConnection (audio (1, 2));
+            model.addConnection (audio (2, 3));
+            
+            WebAudioGraphModel result;
+            expectEquals (WebAudioGraphOptimizer (model).optimize (result), 1);
+            expect (findElementWithName (result, "unity") == nullptr);
+            expect (result.getConnections().contains (audio (1, 3)));
+        }
+        
+        beginTest ("Centred panners are kept");
+        {
+            StringPairArray centred;
+            centred.set ("pan", "0");
+            
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "osc", "OscillatorNode"));
+            model.addElement (makeNode (2, "panner", "StereoPannerNode", centred));
+            model.addElement (makeNode (3, "out", "AnalyserNode"));
+            model.addConnection (audio (1, 2));
+            model.addConnection (audio (2, 3));
+            
+            WebAudioGraphModel result;
+            expectEquals (WebAudioGraphOptimizer (model).optimize (result), 0);
+            expect (findElementWithName (result, "panner") != nullptr);
+            expect (result.getConnections().contains (audio (2, 3)));
+        }
+        
+        beginTest ("Nodes used by the code or automated are left alone");
+        {
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "osc", "OscillatorNode"));
+            model.addElement (makeNode (2, "named", "GainNode", gainOf ("1")));
+            model.addElement (makeNode (3, "automated", "GainNode", gainOf ("1")));
+            model.addElement (makeNode (4, "lfo", "OscillatorNode"));
+            model.addElement (makeNode (5, "out", "AnalyserNode"));
+            model.addElement (makeElement (6, GraphElementType::scriptType, "setup", "named.gain.value = 0;"));
+            model.addConnection (audio (1, 2));
+            model.addConnection (audio (2, 3));
+            model.addConnection (audio (3, 5));
+            model.addConnection ({ 4, 0, WebAudioGraphModel::pinOnBottom, 3, 0, WebAudioGraphModel::pinOnLeft });
+            
+            WebAudioGraphModel result;
+            expectEquals (WebAudioGraphOptimizer (model).optimize (result), 0);
+            expectEquals (result.getConnections().size(), model.getConnections().size());
+        }
+        
+        beginTest ("Identical constant sources are merged");
+        {
+            StringPairArray offset;
+            offset.set ("offset", "0.5");
+            
+            WebAudioGraphModel model;
+            model.addElement (makeNode (1, "first", "ConstantSourceNode", offset));
+            model.addElement (makeNode (2, "second", "ConstantSourceNode", offset));
+            model.addElement (makeNode (3, "outA", "AnalyserNode"));
+            model.addElement (makeNode (4, "outB", "AnalyserNode"));
+            model.addConnection (audio (1, 3));
+            model.addConnection (audio (2, 4));
+            
+            WebAudioGraphModel result;
+            expectEquals (WebAudioGraphOptimizer (model).optimize (result), 1);
+            expect (findElementWithName (result, "second") == nullptr);
+            expect (result.getConnections().contains (audio (1, 3)));
+            expect (result.getConnections().contains (audio (1, 4)));
+        }
+    }
+};
+
+static WebAudioGraphOptimizerTests webAudioGraphOptimizerTests;
@@ -0,0 +1,231 @@
+#include "AudioTranscoder.h"
+#include "ContentHash.h"
+
+String AudioTranscoder::Settings::getFileExtension() const
+{
+    switch (format)
+    {
+        case oggVorbis:     return ".ogg";
+        case flac:          return ".flac";
+        default:            return String();
+    }
+}
+
+void AudioTranscoder::Settings::saveTo (PropertySet& ps) const
+{
+    ps.setValue ("transcodeFormat", getFormatName (format));
+    ps.setValue ("transcodeSampleRate", sampleRate);
+    ps.setValue ("transcodeChannels", numChannels);
+    ps.setValue ("transcodeQuality", quality);
+}
+
+void AudioTranscoder::Settings::loadFrom (const PropertySet& ps)
+{
+    format = getFormatWithName (ps.getValue ("transcodeFormat"));
+    sampleRate = ps.getDoubleValue ("transcodeSampleRate", 0.0);
+    numChannels = ps.getIntValue ("transcodeChannels", 0);
+    quality = ps.getIntValue ("transcodeQuality", 4);
+}
+
+AudioTranscoder::Settings::Format AudioTranscoder::Settings::getFormatWithName (const String& name)
+{
+    if (name.equalsIgnoreCase ("ogg"))
+        return oggVorbis;
+    
+    if (name.equalsIgnoreCase ("flac"))
+        return flac;
+    
+    return keepOriginal;
+}
+
+String AudioTranscoder::Settings::getFormatName (Format f)
+{
+    switch (f)
+    {
+        case oggVorbis:     return "ogg";
+        case flac:          return "flac";
+        default:            return String();
+    }
+}
+
+//==============================================================================
+AudioTranscoder::AudioTranscoder (const Settings& s, const File& cacheDirectory)
+    : settings (s), cacheDir (cacheDirectory)
+{
+}
+
+String AudioTranscoder::getTranscodedName (const String& fileName) const
+{
+    if (! settings.isEnabled())
+        return fileName;
+    
+    return File::createFileWithoutCheckingPath (fileName).getFileNameWithoutExtension() + settings.getFileExtension();
+}
+
+File AudioTranscoder::getTranscodedFile (const File& source) const
+{
+    const String contentHash (getContentHash (source));
+    
+    if (contentHash.isEmpty())
+        return File();
+    
+    const String settingsString (Settings::getFormatName (settings.format) + " "
+                                 + String (settings.sampleRate) + " "
+                                 + String (settings.numChannels) + " "
+                                 + String (settings.quality));
+    
+    const auto cached = cacheDir.getChildFile (contentHash + "_"
+                                               + String::toHexString (settingsString.hashCode())
+                                               + settings.getFileExtension());
+    
+    if (cached.existsAsFile())
+        return cached;
+    
+    if (! cacheDir.isDirectory() && cacheDir.createDirectory().failed())
+        return File();
+    
+    return transcode (source, cached) ? cached : File();
+}
+
+String AudioTranscoder::getContentHash (const File& source) const
+{
+    // One stamp per source path, holding the size and modification time its hash was computed for
+    const auto stampFile = cacheDir.getChildFile ("sources")
+                                   .getChildFile (String::toHexString (source.getFullPathName().hashCode64()) + ".txt");
+    
+    const String stamp (source.getFullPathName() + "\n"
+                        + String (source.getSize()) + "\n"
+                        + String (source.getLastModificationTime().toMilliseconds()) + "\n");
+    
+    const String storedStamp (stampFile.loadFileAsString());
+    
+    if (storedStamp.startsWith (stamp))
+        return storedStamp.substring (stamp.length()).trim();
+    
+    FileInputStream fis (source);
+    
+    if (! fis.openedOk())
+        return String();
+    
+    ContentHash hash;
+    hash.update (fis);
+    
+    // Not being able to write the stamp only means hashing the source again next time
+    if (stampFile.getParentDirectory().createDirectory().wasOk())
+        stampFile.replaceWithText (stamp + hash.toHexString());
+    
+    return hash.toHexString();
+}
+
+//==============================================================================
+namespace
+{
+    // Mixes down to mono, or spreads the source channels over the destination ones
+    void remix (const AudioBuffer<float>& source, AudioBuffer<float>& dest, int numSamples)
+    {
+        const int numSourceChannels = source.getNumChannels();
+        
+        if (dest.getNumChannels() == 1 && numSourceChannels > 1)
+        {
+            dest.copyFrom (0, 0, source, 0, 0, numSamples);
+            
+            for (int c = 1; c < numSourceChannels; ++c)
+                dest.addFrom (0, 0, source, c, 0, numSamples);
+            
+            dest.applyGain (0, 0, numSamples, 1.0f / numSourceChannels);
+            return;
+        }
+        
+        for (int c = 0; c < dest.getNumChannels(); ++c)
+            dest.copyFrom (c, 0, source, c % numSourceChannels, 0, numSamples);
+    }
+}
+
+// The format's bit depth closest to the source's, the highest one on ties. FLAC only takes
+// 16 or 24 bits, which a 20-bit source must be rounded to.
+static int getClosestBitDepth (AudioFormat& format, int sourceBitDepth)
+{
+    int closest = 0;
+    
+    for (auto depth : format.getPossibleBitDepths())
+    {
+        const int distance = std::abs (depth - sourceBitDepth);
+        const int closestDistance = std::abs (closest - sourceBitDepth);
+        
+        if (closest == 0 || distance < closestDistance || (distance == closestDistance && depth > closest))
+            closest = depth;
+    }
+    
+    return closest > 0 ? closest : 16;
+}
+
+bool AudioTranscoder::transcode (const File& source, const File& dest) const
+{
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    
+    ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (source));
+    
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0)
+        return false;
+    
+    const double sampleRate = settings.sampleRate > 0.0 ? settings.sampleRate : reader->sampleRate;
+    const int numSourceChannels = (int) reader->numChannels;
+    const int numChannels = settings.numChannels > 0 ? settings.numChannels : numSourceChannels;
+    ScopedPointer<AudioFormat> format;
+    
+    if (settings.format == Settings::flac)
+        format = new FlacAudioFormat();
+    else
+        format = new OggVorbisAudioFormat();
+    
+    const int bitsPerSample = getClosestBitDepth (*format, (int) reader->bitsPerSample);
+    const int qualityIndex = jlimit (0, jmax (0, format->getQualityOptions().size() - 1), settings.quality);
+    
+    // Encoded next to its final location and renamed once complete, as with the other outputs
+    TemporaryFile temp (dest);
+    
+    {
+        ScopedPointer<OutputStream> out (temp.getFile().createOutputStream());
+        
+        if (out == nullptr)
+            return false;
+        
+        ScopedPointer<AudioFormatWriter> writer (format->createWriterFor (out, sampleRate, (unsigned int) numChannels,
+                                                                          bitsPerSample, {}, qualityIndex));
+        
+        if (writer == nullptr)
+            return false;
+        
+        out.release();  // Now owned by the writer
+        
+        AudioFormatReaderSource readerSource (reader, false);
+        ResamplingAudioSource resampler (&readerSource, false, numSourceChannels);
+        
+        const int blockSize = 8192;
+        resampler.setResamplingRatio (reader->sampleRate / sampleRate);
+        resampler.prepareToPlay (blockSize, sampleRate);
+        
+        const int64 numOutputSamples = (int64) (reader->lengthInSamples * sampleRate / reader->sampleRate);
+        
+        AudioBuffer<float> sourceBlock (numSourceChannels, blockSize);
+        AudioBuffer<float> outputBlock (numChannels, blockSize);
+        
+        for (int64 pos = 0; pos < numOutputSamples; pos += blockSize)
+        {
+            const int numSamples = (int) jmin ((int64) blockSize, numOutputSamples - pos);
+            
+            AudioSourceChannelInfo info (&sourceBlock, 0, numSamples);
+            resampler.getNextAudioBlock (info);
+            
+            remix (sourceBlock, outputBlock, numSamples);
+            
+            if (! writer->writeFromAudioSampleBuffer (outputBlock, 0, numSamples))
+                return false;
+        }
+        
+        resampler.releaseResources();
+    }
+    
+    return temp.overwriteTargetFileWithTemporary();
+}
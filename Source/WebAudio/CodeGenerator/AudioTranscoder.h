@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Converts the project's audio files to a compressed delivery format before they're copied
+// to the output directory. Results are kept in a cache directory, named after a hash of the
+// source's content and of the settings, so a file is only encoded again when one of them changes.
+// A source is only read to be hashed again when its size or modification time changed.
+class AudioTranscoder
+{
+public:
+    struct Settings
+    {
+        enum Format
+        {
+            keepOriginal = 0,
+            oggVorbis,
+            flac
+        };
+        
+        bool isEnabled() const { return format != keepOriginal; }
+        String getFileExtension() const;
+        
+        // Stored in the project config
+        void saveTo (PropertySet& ps) const;
+        void loadFrom (const PropertySet& ps);
+        
+        static Format getFormatWithName (const String& name);
+        static String getFormatName (Format f);
+        
+        Format format = keepOriginal;
+        double sampleRate = 0.0;    // 0 keeps the source's sample rate
+        int numChannels = 0;        // 0 keeps the source's channels
+        int quality = 4;            // Index in the format's quality options
+    };
+    
+    AudioTranscoder (const Settings& settings, const File& cacheDirectory);
+    
+    const Settings& getSettings() const { return settings; }
+    
+    // Returns the transcoded version of the source, encoding it first if it isn't in the
+    // cache yet, or File() if the source can't be read. Safe to call from several threads.
+    File getTranscodedFile (const File& source) const;
+    
+    // The name a file gets once transcoded
+    String getTranscodedName (const String& fileName) const;
+    
+private:
+    String getContentHash (const File& source) const;
+    bool transcode (const File& source, const File& dest) const;
+    
+    const Settings settings;
+    const File cacheDir;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioTranscoder)
+};
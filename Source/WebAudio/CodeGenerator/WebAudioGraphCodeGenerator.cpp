@@ -9,14 +9,37 @@
 */
 
 #include "WebAudioGraphCodeGenerator.h"
+#include "ParallelJobs.h"
+#include "HashMapHelpers.h"
+#include "WebAudioGraphOptimizer.h"
 
-WebAudioGraphGenerator::WebAudioGraphGenerator (WebAudioGraphPanel& webAudioGraph) : graph (webAudioGraph)
+WebAudioGraphGenerator::WebAudioGraphGenerator()
+    : threadPool (ParallelJobs::getDefaultNumThreads())
 {
     libraryCode = String::createStringFromData (BinaryData::wave_js, BinaryData::wave_jsSize);
+    htmlTemplate = String::createStringFromData (BinaryData::index_html, BinaryData::index_htmlSize);
+    
+    for (int i = 0; i < numCachedIndents; ++i)
+        indentTable.add (String::repeatedString (indent, i));
 }
 
-void WebAudioGraphGenerator::generate()
+void WebAudioGraphGenerator::generate (const WebAudioGraphModel& graphModel, int64 snapshotChangeCount)
 {
+    graph = &graphModel;
+    rewrittenElementIds.clear();
+    
+    if (optimizeGraph)
+    {
+        WebAudioGraphOptimizer optimizer (graphModel);
+        optimizer.optimize (optimizedGraph);
+        graph = &optimizedGraph;
+        
+        for (auto id : optimizer.getRewrittenIds())
+            rewrittenElementIds.set (id, true);
+    }
+    
+    fragmentCache.beginPass (snapshotChangeCount);
+    
     // Parameters
     const bool strictMode = true;
     const bool useDefaultContext = true;
@@ -24,71 +47,76 @@ void WebAudioGraphGenerator::generate()
     // Reset state
     useAudioPredecoder = false;
     htmlPage = "";
-    outputScript = "";
     preloadAudioContent = "";
     buttonInfos.clear();
     privateMembers.clear();
     
-    // Output
-    String script;
+    // Output, sized after the previous script as successive generations are usually close
+    const size_t previousScriptSize = scriptOutput.getDataSize();
+    scriptOutput.reset();
+    scriptOutput.preallocate (previousScriptSize + 1024);
+    
+    auto& script = scriptOutput;
     
     // Strict mode directive
     if (strictMode)
     {
-        script += "\"use strict\";";
-        script += newLine + newLine;
+        script << "\"use strict\";";
+        script << newLine << newLine;
     }
     
     // Graph declaration as a module
-    script += "var " + moduleName + " = (function() {";
-    script += newLine;
+    script << "var " << moduleName << " = (function() {";
+    script << newLine;
     
     // Graph initialisation and private members
+    findLiveElements();
     const String initFunctionContent (generateAudioContexts (2));
     const String scriptBodies (generateScriptBodies (1));
     const String dynamicRoutes (generateDynamicRoutes (1));
     preloadAudioContent = generateAudioData (2);
     
     // Forward declaration of private members
-    script += getPrivateMembersDeclaration (1);
+    script << getPrivateMembersDeclaration (1);
     
     // Now function
     if (useDefaultContext)
     {
-        script += getIndent (1) + "let now = function() {" + newLine;
-        script += getIndent (2) + "return ctx.currentTime;" + newLine;
-        script += getIndent (1) + "};" + newLine + newLine;
+        script << getIndent (1) << "let now = function() {" << newLine;
+        script << getIndent (2) << "return ctx.currentTime;" << newLine;
+        script << getIndent (1) << "};" << newLine << newLine;
     }
     
     // Add button declarations
     declareButtons (script, 1);
     
     // Add script elements' functions declarations
-    script += scriptBodies;
+    script << scriptBodies;
     
     // If predecoding is needed, add loadAudio function
     if (useAudioPredecoder)
-        script += getPreloadDeclaration (1);
+        script << getPreloadDeclaration (1);
     
     // Add startAudio function
-    script += getIndent (1) + "let startAudio = function() {";
-    script += newLine;
-    script += initFunctionContent;
+    script << getIndent (1) << "let startAudio = function() {";
+    script << newLine;
+    script << initFunctionContent;
     
     // End of startAudio function
-    script += getIndent (1) + "};";
-    script += newLine + newLine;
+    script << getIndent (1) << "};";
+    script << newLine << newLine;
     
     // Add dynamic routes
-    script += dynamicRoutes;
+    script << dynamicRoutes;
     
     // End of graph module
-    script += "})();";
+    script << "})();";
     
     // Generate html page
     htmlPage = getHtmlPage (getPageTitle(), controllersDivName);
     
-    outputScript = script;
+    fragmentCache.endPass();
+    graph = nullptr;
 }
 
 String WebAudioGraphGenerator::getCoreLibraryCode()
@@ -96,95 +124,296 @@ String WebAudioGraphGenerator::getCoreLibraryCode()
     return libraryCode;
 }
 
+Array<WebAudioGraphGenerator::OutputFile> WebAudioGraphGenerator::getOutputFiles() const
+{
+    auto withFileLineEndings = [] (const String& text)
+    {
+        MemoryOutputStream mos;
+        mos.writeText (text, false, false, "\r\n");
+        return mos.getMemoryBlock();
+    };
+    
+    Array<OutputFile> files;
+    
+    if (liveReload)
+        files.add ({ "js/livereload.js", withFileLineEndings (String::createStringFromData (BinaryData::livereload_js,
+                                                                                           BinaryData::livereload_jsSize)) });
+    
+    if (useAudioPredecoder)
+        files.add ({ "js/wave.js", withFileLineEndings (libraryCode) });
+    
+    // The script's line endings are already "\r\n", it is taken as is from the generator's buffer
+    files.add ({ "js/audio.js", scriptOutput.getMemoryBlock() });
+    files.add ({ "index.html", withFileLineEndings (htmlPage) });
+    files.add ({ "style.css", withFileLineEndings (String::createStringFromData (BinaryData::style_css,
+                                                                                  BinaryData::style_cssSize)) });
+    
+    return files;
+}
+
+void WebAudioGraphGenerator::setRenamedAudioFiles (const StringPairArray& renamed)
+{
+    // The audio data declarations use the delivered names
+    if (renamed != renamedAudioFiles)
+        fragmentCache.forgetElements();
+    
+    renamedAudioFiles = renamed;
+}
+
+void WebAudioGraphGenerator::setElementChangeTrackingEnabled (bool shouldBeEnabled)
+{
+    // The changes made while it was disabled weren't reported
+    if (shouldBeEnabled && ! tracksElementChanges)
+        fragmentCache.forgetElements();
+    
+    tracksElementChanges = shouldBeEnabled;
+}
+
+template <typename FragmentCreator>
+String WebAudioGraphGenerator::getElementFragment (const WebAudioGraphModel::Element& element,
+                                                   const FragmentCache::Key& identity,
+                                                   FragmentCreator createFragment) const
+{
+    // The optimizer's rewrites don't come from the editor, they aren't reported
+    if (! tracksElementChanges || rewrittenElementIds.contains (element.graphId))
+        return createFragment();
+    
+    return fragmentCache.getForElement (element.graphId, identity, createFragment);
+}
+
+void WebAudioGraphGenerator::writeGeneratedScript (OutputStream& destination) const
+{
+    destination.write (scriptOutput.getData(), scriptOutput.getDataSize());
+}
+
 String WebAudioGraphGenerator::getIndent (int indentLevel) const
 {
-    String indentChain;
+    if (isPositiveAndBelow (indentLevel, indentTable.size()))
+        return indentTable[indentLevel];
+    
+    return String::repeatedString (indent, jmax (0, indentLevel));
+}
+
+//==============================================================================
+void WebAudioGraphGenerator::DeferredOutput::flushPendingText()
+{
+    if (pendingText.isNotEmpty())
+    {
+        parts.add ({ pendingText, nullptr, nullptr, 0 });
+        pendingText.clear();
+    }
+}
+
+void WebAudioGraphGenerator::DeferredOutput::addNodeDeclaration (const WebAudioGraphModel::Element& node, int numIndents)
+{
+    flushPendingText();
+    parts.add ({ String(), &node, nullptr, numIndents });
+}
+
+void WebAudioGraphGenerator::DeferredOutput::addConnectionDeclaration (const WebAudioGraphModel::Connection& connection, int numIndents)
+{
+    flushPendingText();
+    parts.add ({ String(), nullptr, &connection, numIndents });
+}
+
+String WebAudioGraphGenerator::DeferredOutput::render (const WebAudioGraphGenerator& generator) const
+{
+    MemoryOutputStream output;
+    
+    for (auto& part : parts)
+    {
+        if (part.node != nullptr)
+            output << generator.getNodeDeclaration (*part.node, part.numIndents);
+        else if (part.connection != nullptr)
+            output << generator.getConnectionDeclaration (*part.connection, part.numIndents);
+        else
+            output << part.text;
+    }
+    
+    output << pendingText;
+    return output.toString();
+}
+
+StringArray WebAudioGraphGenerator::renderInParallel (const Array<const DeferredOutput*>& outputs)
+{
+    StringArray results;
+    results.ensureStorageAllocated (outputs.size());
+    
+    for (int i = 0; i < outputs.size(); ++i)
+        results.add (String());
+    
+    // Each job only writes its own slot, the order of the results doesn't depend on the scheduling
+    if (! outputs.isEmpty())
+        ParallelJobs::run (threadPool, outputs.size(), [&] (int i)
+        {
+            results.getReference (i) = outputs.getUnchecked (i)->render (*this);
+        });
+    
+    return results;
+}
+
+//==============================================================================
+void WebAudioGraphGenerator::findLiveElements()
+{
+    liveElementIds.clear();
+    
+    if (! eliminateDeadNodes)
+        return;
+    
+    // Names used by scripts and messages: these nodes may be used at any time
+    HashMap<String, bool> referencedNames;
+    graph->findIdentifiersUsedInCode (referencedNames);
     
-    for (int i = 0; i < indentLevel; ++i)
-        indentChain += indent;
+    // Edges between nodes in both directions, and nodes targeted by messages
+    HashMap<int, Array<int>> sourcesOfNode;
+    HashMap<int, Array<int>> destinationsOfNode;
+    Array<int> usedNodes;
     
-    return indentChain;
+    for (auto& c : graph->getConnections())
+    {
+        auto source = graph->findElementWithGraphId (c.sourceId);
+        auto dest = graph->findElementWithGraphId (c.destId);
+        
+        if (source->isNode() && dest->isNode())
+        {
+            sourcesOfNode.getReference (c.destId).add (c.sourceId);
+            destinationsOfNode.getReference (c.sourceId).add (c.destId);
+        }
+        else if (source->isMessage() != dest->isMessage())
+        {
+            auto message = source->isMessage() ? source : dest;
+            auto target = source->isMessage() ? dest : source;
+            
+            if (! target->isNode())
+                continue;
+            
+            liveElementIds.set (message->graphId, true);
+            usedNodes.add (target->graphId);
+        }
+    }
+    
+    Array<int> heardNodes;
+    
+    for (int i = 0; i < graph->getNumElements(); ++i)
+    {
+        auto& e = graph->getElement (i);
+        
+        if (e.isDestinationNode())
+            heardNodes.add (e.graphId);
+        else if (e.isNode() && referencedNames.contains (e.name))
+            usedNodes.add (e.graphId);
+    }
+    
+    // What a message or script acts on reaches the nodes after it, which are kept with it even
+    // when they aren't heard. Each node and edge is visited once in each direction.
+    HashMap<int, bool> reachedFromCode;
+    
+    while (! usedNodes.isEmpty())
+    {
+        const int id = usedNodes.removeAndReturn (usedNodes.size() - 1);
+        
+        if (reachedFromCode.contains (id))
+            continue;
+        
+        reachedFromCode.set (id, true);
+        heardNodes.add (id);
+        
+        for (auto destId : HashMapHelpers::find (destinationsOfNode, id))
+            if (! reachedFromCode.contains (destId))
+                usedNodes.add (destId);
+    }
+    
+    // Everything that feeds a destination or a node reached above is live
+    while (! heardNodes.isEmpty())
+    {
+        const int id = heardNodes.removeAndReturn (heardNodes.size() - 1);
+        
+        if (liveElementIds.contains (id))
+            continue;
+        
+        liveElementIds.set (id, true);
+        
+        for (auto sourceId : HashMapHelpers::find (sourcesOfNode, id))
+            if (! liveElementIds.contains (sourceId))
+                heardNodes.add (sourceId);
+    }
+}
+
+bool WebAudioGraphGenerator::isLive (const WebAudioGraphModel::Element& element) const
+{
+    if (! eliminateDeadNodes || ! (element.isNode() || element.isMessage()))
+        return true;
+    
+    return liveElementIds.contains (element.graphId);
 }
 
-void WebAudioGraphGenerator::declareButtons (String& buttonsScript, int indentLevelScript)
+void WebAudioGraphGenerator::declareButtons (OutputStream& buttonsScript, int indentLevelScript)
 {
     const String ind (getIndent (indentLevelScript));
     const String ind2 (getIndent (indentLevelScript + 1));
     const String ind3 (getIndent (indentLevelScript + 2));
     
-    buttonsScript += ind + "let prepareHtmlElements = function() {";
-    buttonsScript += newLine;
-    buttonsScript += ind2 + "var controllersDiv = document.querySelector('#" + controllersDivName + "');";
-    buttonsScript += newLine;
+    buttonsScript << ind << "let prepareHtmlElements = function() {";
+    buttonsScript << newLine;
+    buttonsScript << ind2 << "var controllersDiv = document.querySelector('#" << controllersDivName << "');";
+    buttonsScript << newLine;
     
     for (auto f : buttonInfos)
     {
         const String n (f->name);
         const auto colString = String ("#" + f->colour.toDisplayString (false)).quoted();
         
-        buttonsScript += newLine;
-        buttonsScript += ind2 + "var " + n + "Button = document.createElement ('button');" + newLine;
-        buttonsScript += ind2 + n + "Button.appendChild (document.createTextNode('" + n + "'));" + newLine;
-        buttonsScript += ind2 + n + "Button.onclick = function() {" + newLine;
-        buttonsScript += ind3 + n + "();" + newLine;
-        buttonsScript += ind2 + "}" + newLine + newLine;
-        buttonsScript += ind2 + n + "Button.style.background = " + colString +";" + newLine;
-        buttonsScript += ind2 + "controllersDiv.appendChild (" + n + "Button);" + newLine;
+        buttonsScript << newLine;
+        buttonsScript << ind2 << "var " << n << "Button = document.createElement ('button');" << newLine;
+        buttonsScript << ind2 << n << "Button.appendChild (document.createTextNode('" << n << "'));" << newLine;
+        buttonsScript << ind2 << n << "Button.onclick = function() {" << newLine;
+        buttonsScript << ind3 << n << "();" << newLine;
+        buttonsScript << ind2 << "}" << newLine << newLine;
+        buttonsScript << ind2 << n << "Button.style.background = " << colString << ";" << newLine;
+        buttonsScript << ind2 << "controllersDiv.appendChild (" << n << "Button);" << newLine;
     }
     
-    buttonsScript += ind + "}" + newLine + newLine;
+    buttonsScript << ind << "}" << newLine << newLine;
     
     if (! useAudioPredecoder)
-        buttonsScript += ind + "window.addEventListener ('load', prepareHtmlElements);" + newLine + newLine;
+        buttonsScript << ind << "window.addEventListener ('load', prepareHtmlElements);" << newLine << newLine;
 }
 
-#include "WebAudioGraph.h"
-#include "WebAudioNodeInstance.h"
-#include "WebAudioNode.h"
-#include "WebAudioMessage.h"
-#include "WebAudioData.h"
-#include "WebAudioContext.h"
-#include "WebAudioScript.h"
-#include "WebAudioDynamicRoute.h"
-
 String WebAudioGraphGenerator::generateAudioContexts (int numIndents)
 {
     const bool useDefaultContext = true;
     
     // Audio context prefix
-    String output ((getIndent(numIndents) + audioContextHeader + newLine));
+    MemoryOutputStream output;
+    output << getIndent (numIndents) << audioContextHeader << newLine;
     
     struct DeclaredContext
     {
         const String name;
-        String content;
-        StringArray declaredNodes;
+        DeferredOutput content;
+        NameList declaredNodes;
     };
     
     OwnedArray<DeclaredContext> declaredContexts;
+    HashMap<String, DeclaredContext*> contextsByName;
     
     auto isContextDeclared = [&](String name)
     {
-        for (auto ctx : declaredContexts)
-            if (ctx->name == name)
-                return true;
-        
-        return false;
+        return contextsByName.contains (name);
     };
     
     auto getContextDeclaration = [&](String name)->DeclaredContext*
     {
-        for (auto ctx : declaredContexts)
-            if (ctx->name == name)
-                return ctx;
-        
-        return nullptr;
+        return contextsByName[name];
     };
     
     auto isElementDeclared = [&](String name)->bool
     {
+        if (contextsByName.contains (name))
+            return true;
+        
         for (auto ctx : declaredContexts)
-            if (ctx->name == name || ctx->declaredNodes.contains (name))
+            if (ctx->declaredNodes.contains (name))
                 return true;
         
         return false;
@@ -193,58 +422,58 @@ String WebAudioGraphGenerator::generateAudioContexts (int numIndents)
     StringArray declaredAudioElements;
     
     // Declare default context
-    Array<WebAudioNode*> rootNodes;
+    Array<const WebAudioGraphModel::Element*> rootNodes;
     
     if (useDefaultContext)
     {
-        auto contextDeclaration = new DeclaredContext ({ defaultContextName });
+        auto contextDeclaration = new DeclaredContext { defaultContextName };
         declaredContexts.add (contextDeclaration);
+        contextsByName.set (defaultContextName, contextDeclaration);
         contextDeclaration->declaredNodes.add (defaultContextName + ".destination");
         
-        contextDeclaration->content = newLine;
-        contextDeclaration->content += getIndent (numIndents) + "// Context declaration (default context)" + newLine;
-        contextDeclaration->content += getIndent (numIndents);
-        contextDeclaration->content += defaultContextName + " = new AudioContext();";
-        contextDeclaration->content += newLine + newLine;
+        auto& content = contextDeclaration->content;
+        content << newLine;
+        content << getIndent (numIndents) << "// Context declaration (default context)" << newLine;
+        content << getIndent (numIndents);
+        content << defaultContextName << " = new AudioContext();";
+        content << newLine << newLine;
         
-        rootNodes = graph.getAllNodesWithoutContext (true);
+        rootNodes = graph->getAllNodesWithoutContext (true);
         
         for (auto n : rootNodes)
         {
-            const String identifier (n->getPublicName());
-            const String interf (n->getInterfaceName());
+            const String identifier (n->name);
             
-            if (identifier.contains(".") || graph.getAllDynamicRoutesContaining (n).size() > 0)
+            if (identifier.contains(".") || n->dynamicRouteIds.size() > 0 || ! isLive (*n))
                 continue;
             
-            if (! contextDeclaration->declaredNodes.contains (identifier))
-            {
-                contextDeclaration->content += getNodeDeclaration (n, numIndents);
-                contextDeclaration->declaredNodes.add (identifier);
-            }
+            if (contextDeclaration->declaredNodes.add (identifier))
+                contextDeclaration->content.addNodeDeclaration (*n, numIndents);
         }
     }
     
     // Declare explicit contexts
-    auto contexts = graph.getAllContexts (true);
+    auto contexts = graph->getAllContexts (true);
     
     for (auto c : contexts)
     {
         // Context declaration
-        const String contextIdentifier = c->getPublicName();
+        const String contextIdentifier = c->name;
         DeclaredContext* contextDeclaration;
         bool firstDeclaration = true;
         
         if (! isContextDeclared (contextIdentifier))
         {
-            contextDeclaration = new DeclaredContext ({ contextIdentifier });
+            contextDeclaration = new DeclaredContext { contextIdentifier };
             declaredContexts.add (contextDeclaration);
+            contextsByName.set (contextIdentifier, contextDeclaration);
             contextDeclaration->declaredNodes.add (contextIdentifier + ".destination");
             
-            contextDeclaration->content = newLine;
-            contextDeclaration->content += getIndent (numIndents) + "// Context declaration (" + contextIdentifier + ")" + newLine;
-            contextDeclaration->content += getIndent (numIndents);
-            contextDeclaration->content += contextIdentifier + " = new " + c->getInterfaceName() + "();";
+            auto& content = contextDeclaration->content;
+            content << newLine;
+            content << getIndent (numIndents) << "// Context declaration (" << contextIdentifier << ")" << newLine;
+            content << getIndent (numIndents);
+            content << contextIdentifier << " = new " << c->interfaceName << "();";
         }
         else
         {
@@ -255,50 +484,42 @@ String WebAudioGraphGenerator::generateAudioContexts (int numIndents)
         if (contextDeclaration == nullptr)
             continue;
         
-        auto nodes = c->getAllNodes (true);
+        auto nodes = graph->getAllNodesInContext (c->graphId, true);
         
-        String& destination = contextDeclaration->content;
-        StringArray& declaredNodes = contextDeclaration->declaredNodes;
+        auto& destination = contextDeclaration->content;
+        NameList& declaredNodes = contextDeclaration->declaredNodes;
         
         // Nodes declaration
         if (firstDeclaration)
-            destination += newLine;
+            destination << newLine;
         
         for (auto n : nodes)
         {
-            const String identifier (n->getPublicName());
-            const String interf (n->getInterfaceName());
+            const String identifier (n->name);
             
-            if (identifier.contains(".") || graph.getAllDynamicRoutesContaining(n).size() > 0)
-                continue; // Attributes and dynamic nodes shouldn't be declared
+            if (identifier.contains(".") || n->dynamicRouteIds.size() > 0 || ! isLive (*n))
+                continue; // Attributes, dynamic and dead nodes shouldn't be declared
             
-            if (! declaredNodes.contains (identifier))
-            {
-                destination += getNodeDeclaration (n, numIndents);
-                declaredNodes.add (n->getPublicName());
-            }
+            if (declaredNodes.add (identifier))
+                destination.addNodeDeclaration (*n, numIndents);
         }
     }
     
-    Array<ConnectionInfo> connectionsAdded;
-    
-    // Make connections
-    for (auto c : graph.getGraphPanel().getConnections())
+    // Make connections. The model holds each connection once.
+    for (auto& info : graph->getConnections())
     {
-        const auto info = c->getInfo();
-        
-        if (connectionsAdded.contains (info))
-            continue;
+        const auto sourceComp = graph->findElementWithGraphId (info.sourceId);
+        const auto destComp = graph->findElementWithGraphId (info.destId);
         
-        const String sourceName (info.sourceComp->getPublicName());
-        const String destName (info.destComp->getPublicName());
-        const bool destIsContextDestination = dynamic_cast<WebAudioDestinationNode*> (info.destComp);
+        const String sourceName (sourceComp->name);
+        const String destName (destComp->name);
+        const bool destIsContextDestination = destComp->isDestinationNode();
         
         // We need to find the context name in order to get the right destination string
         String contextName;
         
-        if (auto n = dynamic_cast<WebAudioNode*> (info.sourceComp))
-            contextName = n->getAudioContextName();
+        if (sourceComp->isNode())
+            contextName = graph->getContextName (*sourceComp);
         
         if (contextName.isEmpty() && useDefaultContext)
             contextName = defaultContextName;
@@ -308,48 +529,51 @@ String WebAudioGraphGenerator::generateAudioContexts (int numIndents)
         if (ctxDeclaration == nullptr)
             continue;
         
-        String& destination = ctxDeclaration->content;
+        auto& destination = ctxDeclaration->content;
         
         if (! ctxDeclaration->declaredNodes.contains (sourceName)
             || (! destIsContextDestination && ! ctxDeclaration->declaredNodes.contains (destName)))
             continue;
         
-        destination += getConnectionDeclaration (info, numIndents);
-        
-        connectionsAdded.add (info);
+        destination.addConnectionDeclaration (info, numIndents);
     }
 
-    // Concat context declarations
+    // Create the contexts' declarations independently, then concat them in declaration order
+    Array<const DeferredOutput*> contents;
+    
     for (auto declaration : declaredContexts)
-        output += declaration->content;
+        contents.add (&declaration->content);
+    
+    for (auto& content : renderInParallel (contents))
+        output << content;
     
     // Process messages and scripts at root
-    auto sm = graph.getAllScriptsAndMessagesAtRoot (true);
+    auto sm = graph->getAllScriptsAndMessagesAtRoot (true);
     
     if (sm.size() > 0)
-        output += newLine;
+        output << newLine;
     
     for (auto scriptOrMsg : sm)
     {
-        if (auto msg = dynamic_cast<WebAudioMessage*> (scriptOrMsg))
+        if (scriptOrMsg->isMessage())
         {
-            for (auto emb : graph.getGraphPanel().getAllConnected (msg, GraphEmbeddedComponent::Pin::PinOnLeft))
+            for (auto emb : graph->getAllConnected (*scriptOrMsg, WebAudioGraphModel::pinOnLeft))
             {
-                const String targetName (emb->getPublicName());
+                const String targetName (emb->name);
                 
                 if (! (isElementDeclared (targetName) || declaredAudioElements.contains (targetName)))
                     continue;
                 
-                output += getIndent (numIndents);
-                output += emb->getPublicName() + "." + msg->getPublicName() + ";";
-                output += newLine;
+                output << getIndent (numIndents);
+                output << targetName << "." << scriptOrMsg->name << ";";
+                output << newLine;
             }
         }
-        else if (auto s = dynamic_cast<WebAudioScript*> (scriptOrMsg))
+        else if (scriptOrMsg->isScript())
         {
-            output += getIndent (numIndents);
-            output += s->getPublicName() + "();";
-            output += newLine;
+            output << getIndent (numIndents);
+            output << scriptOrMsg->name << "();";
+            output << newLine;
         }
     }
     
@@ -360,17 +584,17 @@ String WebAudioGraphGenerator::generateAudioContexts (int numIndents)
     for (auto ctx : declaredContexts)
     {
         if (! ctx->name.contains ("."))
-            privateMembers.addIfNotAlreadyThere (ctx->name);
+            privateMembers.add (ctx->name);
         
-        for (auto n : ctx->declaredNodes)
+        for (auto n : ctx->declaredNodes.names)
             if (!n.contains ("."))
-                privateMembers.addIfNotAlreadyThere (n);
+                privateMembers.add (n);
     }
     
     for (auto e : declaredAudioElements)
-        privateMembers.addIfNotAlreadyThere (e);
+        privateMembers.add (e);
     
-    return output;
+    return output.toString();
 }
 
 String WebAudioGraphGenerator::generateDynamicRoutes (int numIndents)
@@ -378,43 +602,53 @@ String WebAudioGraphGenerator::generateDynamicRoutes (int numIndents)
     struct DeclaredRoute
     {
         const String name;
-        String nodeDeclarations;
-        String connectionDeclarations;
-        String messageDeclarations;
-        StringArray declaredNodes;
+        DeferredOutput nodeDeclarations;
+        DeferredOutput connectionDeclarations;
+        MemoryOutputStream messageDeclarations;
+        NameList declaredNodes;
         Colour colour;
     };
     
     OwnedArray<DeclaredRoute> declaredRoutes;
+    HashMap<String, DeclaredRoute*> routesByName;
     
     auto isRouteDeclared = [&](String name)
     {
-        for (auto f : declaredRoutes)
-            if (f->name == name)
-                return true;
-        
-        return false;
+        return routesByName.contains (name);
     };
     
     auto getRouteDeclaration = [&](String name)->DeclaredRoute*
     {
-        for (auto f : declaredRoutes)
-            if (f->name == name)
-                return f;
-        
-        return nullptr;
+        return routesByName[name];
     };
     
+    // Indices of the connections of each node, so that each route only visits its own ones
+    HashMap<int, Array<int>> connectionsOfNode;
+    const auto& connections = graph->getConnections();
+    
+    for (int i = 0; i < connections.size(); ++i)
+    {
+        const auto& info = connections.getReference (i);
+        
+        if (info.sourcePlacement == WebAudioGraphModel::pinOnRight)
+            continue;
+        
+        connectionsOfNode.getReference (info.sourceId).add (i);
+        
+        if (info.destId != info.sourceId)
+            connectionsOfNode.getReference (info.destId).add (i);
+    }
+    
     const String ind (getIndent (numIndents));
     const String ind2 (getIndent (numIndents + 1));
     
-    auto dynamicRoutes = graph.getAllDynamicRoutes (true);
+    auto dynamicRoutes = graph->getAllDynamicRoutes (true);
     
     for (auto f : dynamicRoutes)
     {
-        Array<GraphEmbeddedComponent*> nodesToConnect;
+        Array<int> nodesToConnect;
         
-        const String routeName (f->getPublicName());
+        const String routeName (f->name);
         const bool isAlreadyDeclared (isRouteDeclared (routeName));
         
         // Get DeclaredRoute for this element
@@ -422,9 +656,10 @@ String WebAudioGraphGenerator::generateDynamicRoutes (int numIndents)
         
         if (! isAlreadyDeclared)
         {
-            routeDeclaration = new DeclaredRoute ({ routeName });
-            routeDeclaration->colour = f->getBackgroundColour().withAlpha(1.0f);
+            routeDeclaration = new DeclaredRoute { routeName };
+            routeDeclaration->colour = f->colour.withAlpha(1.0f);
             declaredRoutes.add (routeDeclaration);
+            routesByName.set (routeName, routeDeclaration);
         }
         else
             routeDeclaration = getRouteDeclaration (routeName);
@@ -434,238 +669,320 @@ String WebAudioGraphGenerator::generateDynamicRoutes (int numIndents)
         
         // Declare nodes for this element
         auto& nodeDeclarations = routeDeclaration->nodeDeclarations;
-        auto nodes = f->getAllNodes (true);
+        auto nodes = graph->getAllNodesInDynamicRoute (f->graphId, true);
         
         for (auto n : nodes)
         {
-            if (auto dest = dynamic_cast<WebAudioDestinationNode*> (n))
+            if (n->isDestinationNode() || ! isLive (*n))
                 continue;
             
-            const String nodeName (n->getPublicName());
+            const String nodeName (n->name);
             
             if (routeDeclaration->declaredNodes.contains (nodeName)
                 || privateMembers.contains (nodeName))  // We don't want to 'override' nodes declared at root
                 continue;
             
-            nodeDeclarations += getNodeDeclaration (n, numIndents + 1);
+            nodeDeclarations.addNodeDeclaration (*n, numIndents + 1);
             routeDeclaration->declaredNodes.add (nodeName);
-            nodesToConnect.add (n);
+            nodesToConnect.add (n->graphId);
         }
         
-        // Connect nodes for this element
+        // Connect nodes for this element, in the graph's order
         auto& connectionDeclarations = routeDeclaration->connectionDeclarations;
+        SortedSet<int> connectionIndices;
         
-        for (auto c : graph.getGraphPanel().getConnections())
-        {
-            auto info = c->getInfo();
-            
-            if (info.sourcePlacement == GraphEmbeddedComponent::Pin::PinOnRight)
-                continue;
-            
-            if (nodesToConnect.contains (info.sourceComp) || nodesToConnect.contains (info.destComp))
-                connectionDeclarations += getConnectionDeclaration (info, numIndents + 1);
-        }
+        for (auto id : nodesToConnect)
+            if (connectionsOfNode.contains (id))
+                for (auto i : connectionsOfNode.getReference (id))
+                    connectionIndices.add (i);
+        
+        for (auto i : connectionIndices)
+            connectionDeclarations.addConnectionDeclaration (connections.getReference (i), numIndents + 1);
         
         // Add scripts and msgs this element
         auto& messagesDeclaration = routeDeclaration->messageDeclarations;
         
-        for (auto scriptOrMsg : f->getAllScriptsAndMessages (true))
+        for (auto scriptOrMsg : graph->getAllScriptsAndMessagesInDynamicRoute (f->graphId, true))
         {
-            if (auto msg = dynamic_cast<WebAudioMessage*> (scriptOrMsg))
+            if (scriptOrMsg->isMessage())
             {
-                const auto msgContent = msg->getPublicName();
+                const auto msgContent = scriptOrMsg->name;
                 
-                if (msgContent.isEmpty())// || msg->getErrorMessage().isNotEmpty())
+                if (msgContent.isEmpty() || ! isLive (*scriptOrMsg))// || msg->getErrorMessage().isNotEmpty())
                     continue;
                 
-                for (auto emb : graph.getGraphPanel().getAllConnected (msg, GraphEmbeddedComponent::Pin::PinOnLeft))
+                for (auto emb : graph->getAllConnected (*scriptOrMsg, WebAudioGraphModel::pinOnLeft))
                 {
-                    messagesDeclaration += ind2;
-                    messagesDeclaration += emb->getPublicName() + "." + msgContent + ";";
-                    messagesDeclaration += newLine;
+                    if (! isLive (*emb))
+                        continue;
+                    
+                    messagesDeclaration << ind2;
+                    messagesDeclaration << emb->name << "." << msgContent << ";";
+                    messagesDeclaration << newLine;
                 }
             }
-            else if (auto f = dynamic_cast<WebAudioScript*> (scriptOrMsg))
+            else if (scriptOrMsg->isScript())
             {
-                messagesDeclaration += ind2;
-                messagesDeclaration += f->getPublicName() + "();";
-                messagesDeclaration += newLine;
+                messagesDeclaration << ind2;
+                messagesDeclaration << scriptOrMsg->name << "();";
+                messagesDeclaration << newLine;
             }
         }
     }
     
-    // Merge declarations into output
-    String output;
+    // Create the routes' declarations independently
+    Array<const DeferredOutput*> declarationsToRender;
     
     for (auto declaration : declaredRoutes)
     {
-        String content (declaration->nodeDeclarations);
-        content += declaration->connectionDeclarations;
-        
-        if (declaration->connectionDeclarations.isNotEmpty() && declaration->messageDeclarations.isNotEmpty())
-            content += newLine;
+        declarationsToRender.add (&declaration->nodeDeclarations);
+        declarationsToRender.add (&declaration->connectionDeclarations);
+    }
+    
+    const auto rendered = renderInParallel (declarationsToRender);
+    
+    // Merge declarations into output, in declaration order
+    MemoryOutputStream output;
+    
+    for (int i = 0; i < declaredRoutes.size(); ++i)
+    {
+        auto declaration = declaredRoutes.getUnchecked (i);
+        const String& nodeDeclarations = rendered[2 * i];
+        const String& connectionDeclarations = rendered[2 * i + 1];
         
-        content += declaration->messageDeclarations;
+        const bool hasConnections = connectionDeclarations.isNotEmpty();
+        const bool hasMessages = declaration->messageDeclarations.getDataSize() > 0;
         
-        if (content.isEmpty())
+        if (nodeDeclarations.isEmpty() && ! hasConnections && ! hasMessages)
             continue;
         
-        for (auto n : declaration->declaredNodes)
-            privateMembers.addIfNotAlreadyThere(n);
+        for (auto n : declaration->declaredNodes.names)
+            privateMembers.add (n);
         
-        output += ind + "let " + declaration->name + " = function() {";
-        output += newLine;
-        output += content;
-        output += ind + "}";
-        output += newLine + newLine;
+        output << ind << "let " << declaration->name << " = function() {";
+        output << newLine;
+        output << nodeDeclarations;
+        output << connectionDeclarations;
+        
+        if (hasConnections && hasMessages)
+            output << newLine;
+        
+        output << declaration->messageDeclarations;
+        output << ind << "}";
+        output << newLine << newLine;
         
         buttonInfos.add (new ButtonInfo ({ declaration->name, declaration->colour }));
     }
     
-    return output;
+    return output.toString();
 }
 
 String WebAudioGraphGenerator::generateAudioData (int numIndents)
 {
-    auto dataElements = graph.getAllAudioData();
+    auto dataElements = graph->getAllAudioData();
         
-    String output;
+    MemoryOutputStream output;
     
-    const String ctx ("adCtx");
-    output += getIndent (numIndents) + "let " + ctx + " = new AudioContext();" + newLine + newLine;
+    output << getIndent (numIndents) << "let " << audioDataContextName << " = new AudioContext();" << newLine << newLine;
     
     for (auto d : dataElements)
     {
-        const String ind (getIndent (numIndents));
-        const String ind2 (getIndent (numIndents + 1));
-        
-        const auto interfaceName = d->getInterfaceName();
-        const auto instanceName = d->getPublicName();
-        const auto instance = d->getInstance();
+        const auto instanceName = d->name;
         
-        if (instance == nullptr || privateMembers.contains (instanceName))
+        if (! d->hasInstance || privateMembers.contains (instanceName))
             continue;
         
-        const auto& opt = instance->getOptions();
-        
-        if (interfaceName == "AudioBuffer")
+        if (d->interfaceName == "DecodableAudio" && ! useAudioPredecoder)
         {
-            output += ind + instanceName + " = " + ctx + ".createBuffer(";
-            
-            for (int i = 0; i < opt.size(); ++i)
-            {
-                if (i > 0)
-                    output += ", ";
-                
-                const String v (opt.getUnchecked (i)->defaultValue);
-                output += v.isEmpty() ? "0" : v;
-            }
-            
-            output += String (");") + newLine + newLine;
+            const String bundleArgument (audioBundleUrl.isEmpty() ? String() : audioBundleUrl.quoted());
+            output << getIndent (numIndents) << "let predecoder = new AudioPredecoder(" << bundleArgument << ");" << newLine << newLine;
+            useAudioPredecoder = true;
         }
-        else if (interfaceName == "DecodableAudio")
+        
+        output << getAudioDataDeclaration (*d, numIndents);
+        
+        privateMembers.add (instanceName);
+    }
+    
+    return output.toString();
+}
+
+String WebAudioGraphGenerator::getAudioDataDeclaration (const WebAudioGraphModel::Element& d, int numIndents) const
+{
+    FragmentCache::Key identity;
+    identity << "data" << d.name << d.interfaceName << numIndents;
+    
+    return getElementFragment (d, identity, [&]
+    {
+        // Urls of transcoded files point at their delivered name
+        auto opt = d.options;
+        
+        for (auto& o : opt)
+            if (o.name == "url" || o.name == "src")
+                o.value = getDeliveredUrl (o.value);
+        
+        auto key = identity;
+        
+        for (auto& o : opt)
+            key << o.name << o.value;
+        
+        return fragmentCache.get (key, [&] { return createAudioDataDeclaration (d, opt, numIndents); });
+    });
+}
+
+String WebAudioGraphGenerator::createAudioDataDeclaration (const WebAudioGraphModel::Element& d,
+                                                           const Array<WebAudioGraphModel::Option>& opt,
+                                                           int numIndents) const
+{
+    const String ind (getIndent (numIndents));
+    const String& ctx = audioDataContextName;
+    
+    const auto interfaceName = d.interfaceName;
+    const auto instanceName = d.name;
+    
+    String output;
+    
+    if (interfaceName == "AudioBuffer")
+    {
+        output += ind + instanceName + " = " + ctx + ".createBuffer(";
+        
+        for (int i = 0; i < opt.size(); ++i)
         {
-            if (! useAudioPredecoder)
-            {
-                output += ind + "let predecoder = new AudioPredecoder();" + newLine + newLine;
-                useAudioPredecoder = true;
-            }
-            
-            output += ind + instanceName + " = new DecodableAudio (predecoder, " + ctx;
-            
-            for (int i = 0; i < opt.size(); ++i)
-            {
+            if (i > 0)
                 output += ", ";
-                
-                const String v (opt.getUnchecked (i)->defaultValue);
-                output += v.isEmpty() ? "0" : v;
-            }
-            
-            output += String (");") + newLine + newLine;
             
-            useAudioPredecoder = true;
+            const String v (opt.getReference (i).value);
+            output += v.isEmpty() ? "0" : v;
         }
-        else if (interfaceName == "AudioElement")
+        
+        output += String (");") + newLine + newLine;
+    }
+    else if (interfaceName == "DecodableAudio")
+    {
+        output += ind + instanceName + " = new DecodableAudio (predecoder, " + ctx;
+        
+        for (int i = 0; i < opt.size(); ++i)
         {
-            output += ind + instanceName + " = document.createElement(\'audio\');" + newLine;
+            output += ", ";
             
-            for (int i = 0; i < opt.size(); ++i)
-            {
-                const String lineStart (ind + instanceName + ".");
-                const String attrib (opt.getUnchecked(i)->name);
-                const String v (opt.getUnchecked(i)->defaultValue);
-                
-                if (v.isNotEmpty())
-                    output += lineStart + attrib + " = " + v + ";" + newLine;
-            }
+            const String v (opt.getReference (i).value);
+            output += v.isEmpty() ? "0" : v;
+        }
+        
+        output += String (");") + newLine + newLine;
+    }
+    else if (interfaceName == "AudioElement")
+    {
+        output += ind + instanceName + " = document.createElement(\'audio\');" + newLine;
+        
+        for (int i = 0; i < opt.size(); ++i)
+        {
+            const String lineStart (ind + instanceName + ".");
+            const String attrib (opt.getReference (i).name);
+            const String v (opt.getReference (i).value);
             
-            output += ind + "document.querySelector(\"#controllers\").appendChild (" + instanceName + ");" + newLine;
+            if (v.isNotEmpty())
+                output += lineStart + attrib + " = " + v + ";" + newLine;
         }
         
-        privateMembers.add (instanceName);
+        output += ind + "document.querySelector(\"#controllers\").appendChild (" + instanceName + ");" + newLine;
     }
     
     return output;
 }
 
+String WebAudioGraphGenerator::getDeliveredUrl (const String& quotedUrl) const
+{
+    // Same form as AudioFileItem::getDataUrl()
+    const String url (quotedUrl.unquoted());
+    const String dataPrefix ("/data/");
+    
+    if (! url.startsWith (dataPrefix))
+        return quotedUrl;
+    
+    const String fileName (url.substring (dataPrefix.length()));
+    
+    if (! renamedAudioFiles.containsKey (fileName))
+        return quotedUrl;
+    
+    return (dataPrefix + renamedAudioFiles[fileName]).quoted();
+}
+
 String WebAudioGraphGenerator::generateScriptBodies (int numIndents) const
 {
     StringArray declaredScripts;
     String output;
     
-    auto scripts = graph.getAllScripts();
+    auto scripts = graph->getAllScripts();
     
     const String ind (getIndent (numIndents));
     const String ind2 (getIndent (numIndents + 1));
     
     for (auto s : scripts)
     {
-        const String scriptName (s->getPublicName());
+        const String scriptName (s->name);
         
         if (declaredScripts.contains (scriptName))
             continue;
         
         declaredScripts.add (scriptName);
         
-        const StringArray lines (StringArray::fromLines (s->getEditorContent()));
-        
-        output += ind + "let " + scriptName + " = function() {" + newLine;
+        FragmentCache::Key key;
+        key << "script" << scriptName << s->scriptContent << numIndents;
         
-        for (auto l : lines)
-            output += ind2 + l + newLine;
-        
-        output += ind + "};" + newLine + newLine;
+        output += fragmentCache.get (key, [&]
+        {
+            const StringArray lines (StringArray::fromLines (s->scriptContent));
+            
+            String body (ind + "let " + scriptName + " = function() {" + newLine);
+            
+            for (auto l : lines)
+                body += ind2 + l + newLine;
+            
+            body += ind + "};" + newLine + newLine;
+            return body;
+        });
     }
     
     return output;
 }
 
-String WebAudioGraphGenerator::getNodeDeclaration (const WebAudioNode* n, int numIndents) const
+String WebAudioGraphGenerator::getNodeDeclaration (const WebAudioGraphModel::Element& n, int numIndents) const
 {
-    if (n == nullptr)
+    if (! n.hasInstance || n.interfaceName.isEmpty())
         return String();
     
-    auto instance = n->getInstance();
-    
-    if (instance == nullptr)
-        return String();
+    const String contextName (graph->getContextName (n));
     
-    const String identifier (n->getPublicName());
-    const String contextIdentifier (n->getAudioContext() == nullptr ? "ctx" : n->getAudioContextName());
-    const String interf (n->getInterfaceName());
+    FragmentCache::Key identity;
+    identity << "node" << n.name << n.interfaceName << contextName << numIndents;
     
-    if (interf == String())
-        return String();
+    return getElementFragment (n, identity, [&]
+    {
+        auto key = identity;
+        
+        for (auto& o : n.options)
+            key << o.name << o.value;
         
+        return fragmentCache.get (key, [&] { return createNodeDeclaration (n, contextName, numIndents); });
+    });
+}
+
+String WebAudioGraphGenerator::createNodeDeclaration (const WebAudioGraphModel::Element& n, const String& contextName, int numIndents) const
+{
+    const String identifier (n.name);
+    const String contextIdentifier (contextName.isEmpty() ? "ctx" : contextName);
+    const String interf (n.interfaceName);
+    
     // Constructors and options
-    auto& options = instance->getOptions();
+    auto& options = n.options;
     
     String optionsString ("{");
     bool firstLine = true;
     
-    for (auto o : options)
+    for (auto& o : options)
     {
-        const String optionValue = o->defaultValue;
+        const String optionValue = o.value;
         
         if (optionValue == String())
             continue;
@@ -674,7 +991,7 @@ String WebAudioGraphGenerator::getNodeDeclaration (const WebAudioNode* n, int nu
             optionsString += ",";
         
         optionsString += newLine;
-        optionsString += getIndent (numIndents + 1) + o->name + ": " + optionValue;
+        optionsString += getIndent (numIndents + 1) + o.name + ": " + optionValue;
         
         firstLine = false;
     }
@@ -695,29 +1012,52 @@ String WebAudioGraphGenerator::getNodeDeclaration (const WebAudioNode* n, int nu
     return declaration;
 }
 
-String WebAudioGraphGenerator::getConnectionDeclaration (const ConnectionInfo& info, int numIndents) const
+String WebAudioGraphGenerator::getConnectionDeclaration (const WebAudioGraphModel::Connection& info, int numIndents) const
 {
-    if (auto destMsg = dynamic_cast<WebAudioMessage*>(info.destComp))
+    const auto sourceComp = graph->findElementWithGraphId (info.sourceId);
+    const auto destComp = graph->findElementWithGraphId (info.destId);
+    
+    if (sourceComp == nullptr || destComp == nullptr || ! isLive (*sourceComp) || ! isLive (*destComp))
         return String();
     
-    if (auto sourceMsg = dynamic_cast<WebAudioMessage*>(info.sourceComp))
+    // Everything the declaration depends on: the pins, the elements' names and types,
+    // the destination context and the name of the connected audio param
+    FragmentCache::Key key;
+    key << "connection" << info.sourceIndex << (int) info.sourcePlacement
+        << info.destIndex << (int) info.destPlacement << numIndents
+        << sourceComp->name << sourceComp->type << destComp->name << destComp->type
+        << graph->getContextName (*destComp) << (int) destComp->hasInstance;
+    
+    if (isPositiveAndBelow (info.destIndex, destComp->options.size()))
+        key << destComp->options.getReference (info.destIndex).name;
+    
+    return fragmentCache.get (key, [&] { return createConnectionDeclaration (info, sourceComp, destComp, numIndents); });
+}
+
+String WebAudioGraphGenerator::createConnectionDeclaration (const WebAudioGraphModel::Connection& info,
+                                                            const WebAudioGraphModel::Element* sourceComp,
+                                                            const WebAudioGraphModel::Element* destComp,
+                                                            int numIndents) const
+{
+    if (destComp->isMessage())
+        return String();
+    
+    if (sourceComp->isMessage())
         return String();
     
     // From node to audio param
-    if (info.destPlacement == GraphEmbeddedComponent::Pin::PinOnLeft
-        && info.sourcePlacement == GraphEmbeddedComponent::Pin::PinOnBottom)
+    if (info.destPlacement == WebAudioGraphModel::pinOnLeft
+        && info.sourcePlacement == WebAudioGraphModel::pinOnBottom)
     {
-        auto destNode = dynamic_cast<WebAudioNode*>(info.destComp);
-        
-        if (destNode == nullptr)
+        if (! destComp->isNode())
             return String();
         
-        if (auto instance = destNode->getInstance())
+        if (destComp->hasInstance && isPositiveAndBelow (info.destIndex, destComp->options.size()))
         {
-            const auto& options = instance->getOptions();
+            const auto& options = destComp->options;
             
-            const String sourceName = info.sourceComp->getPublicName();
-            const String destName = destNode->getPublicName() + "." + options[info.destIndex]->name;
+            const String sourceName = sourceComp->name;
+            const String destName = destComp->name + "." + options.getReference (info.destIndex).name;
             
             return getIndent (numIndents) + sourceName + ".connect(" + destName + ");" + newLine;
         }
@@ -728,11 +1068,11 @@ String WebAudioGraphGenerator::getConnectionDeclaration (const ConnectionInfo& i
     else
     {
         // to ctx destination node
-        if (auto destinationNode = dynamic_cast<WebAudioDestinationNode*> (info.destComp))
+        if (destComp->isDestinationNode())
         {
-            const String ctx = destinationNode->getAudioContext() == nullptr
-                                ? "ctx" : destinationNode->getAudioContextName();
-            const String sourceName = info.sourceComp->getPublicName();
+            const String contextName = graph->getContextName (*destComp);
+            const String ctx = contextName.isEmpty() ? "ctx" : contextName;
+            const String sourceName = sourceComp->name;
             const String inputArg = info.destIndex > 0 ? ", " + String (info.destIndex) : "";
             const String outputArg = (info.sourceIndex > 0 || inputArg.isNotEmpty()) ? ", " + String (info.sourceIndex) : "";
             
@@ -740,8 +1080,8 @@ String WebAudioGraphGenerator::getConnectionDeclaration (const ConnectionInfo& i
         }
         
         // to a regular node
-        const String sourceName = info.sourceComp->getPublicName();
-        const String destName = info.destComp->getPublicName();
+        const String sourceName = sourceComp->name;
+        const String destName = destComp->name;
         const String inputArg = info.destIndex > 0 ? ", " + String (info.destIndex) : "";
         const String outputArg = (info.sourceIndex > 0 || inputArg.isNotEmpty()) ? ", " + String (info.sourceIndex) : "";
         
@@ -749,38 +1089,69 @@ String WebAudioGraphGenerator::getConnectionDeclaration (const ConnectionInfo& i
     }
 }
 
-String WebAudioGraphGenerator::getHtmlPage (const String &pageName, String &controllersName)
+String WebAudioGraphGenerator::getHtmlPage (const String& pageName, const String& controllersName) const
 {
-    String s (String::createStringFromData (BinaryData::index_html, BinaryData::index_htmlSize));
-    s = s.replace ("($title)", pageName);
-    return s.replace ("($controllersdiv)", controllersName);
-    //return s;
+    StringPairArray substitutions;
+    substitutions.set ("($title)", pageName);
+    substitutions.set ("($controllersdiv)", controllersName);
+    substitutions.set ("($livereload)", liveReload ? "<script src=\"js/livereload.js\"></script>\n      " : "");
+    
+    const auto& keys = substitutions.getAllKeys();
+    const auto& values = substitutions.getAllValues();
+    
+    // Single pass over the template: text is copied chunk by chunk up to each "($...)" token
+    MemoryOutputStream page ((size_t) htmlTemplate.getNumBytesAsUTF8() + 256);
+    auto text = htmlTemplate.getCharPointer();
+    auto chunkStart = text;
+    
+    auto writeChunk = [&] (CharPointer_UTF8 chunkEnd)
+    {
+        page.write (chunkStart.getAddress(), (size_t) (chunkEnd.getAddress() - chunkStart.getAddress()));
+    };
+    
+    while (! text.isEmpty())
+    {
+        if (*text == '(' && text[1] == '$')
+        {
+            auto tokenEnd = text;
+            
+            while (! tokenEnd.isEmpty() && *tokenEnd++ != ')')
+            {}
+            
+            const int index = keys.indexOf (String (text, tokenEnd));
+            
+            if (index >= 0)
+            {
+                writeChunk (text);
+                page << values[index];
+                chunkStart = tokenEnd;
+            }
+            
+            text = tokenEnd;
+        }
+        else
+        {
+            ++text;
+        }
+    }
+    
+    writeChunk (text);
+    
+    return page.toString();
 }
 
-#include "Project.h"
 String WebAudioGraphGenerator::getPageTitle() const
 {
-    const auto& proj = graph.getProject();
-    return proj.isTemporary() ? "WebAudio graph" : proj.getName();
+    const auto& title = graph->getPageTitle();
+    return title.isEmpty() ? "WebAudio graph" : title;
 }
 
 String WebAudioGraphGenerator::getPrivateMembersDeclaration (int numIndents) const
 {
-    if (privateMembers.isEmpty())
+    if (privateMembers.names.isEmpty())
         return String();
     
-    
-    String str ("let ");
-    
-    for (int i = 0; i < privateMembers.size(); ++i)
-    {
-        str << privateMembers[i];
-        
-        if (i + 1 < privateMembers.size())
-            str << ", ";
-    }
-    
-    str << ";";
+    const String str ("let " + privateMembers.names.joinIntoString (", ") + ";");
     
     return getIndent (numIndents) + str + newLine + newLine;
 }
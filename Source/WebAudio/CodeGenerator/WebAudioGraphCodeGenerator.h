@@ -11,50 +11,137 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
-
-class WebAudioGraphPanel;
-class WebAudioNode;
-class ConnectionInfo;
+#include "WebAudioGraphModel.h"
 
 class WebAudioGraphGenerator
 {
 public:
-    WebAudioGraphGenerator (WebAudioGraphPanel& webAudioGraph);
+    WebAudioGraphGenerator();
     
-    void generate();
+    // Only reads the model, no GUI component is needed. The model is the generator's snapshot of the
+    // graph: it mustn't change until generate() returns, as parts of it are read from other threads.
+    // When element changes are tracked and the model was taken before generate() is called (e.g. on
+    // another thread), pass the getElementChangeCount() read with the model, so that elements
+    // changed in between aren't reused from it.
+    void generate (const WebAudioGraphModel& graphModel, int64 snapshotChangeCount = -1);
     
-    const String& getGeneratedScript() const { return outputScript; }
+    String getGeneratedScript() const { return scriptOutput.toString(); }
+    void writeGeneratedScript (OutputStream& destination) const;
     const String& getGeneratedHtmlPage() const { return htmlPage; }
     bool isUsingCoreLibrary() const { return useAudioPredecoder; }
     
     String getCoreLibraryCode();
     
+    struct OutputFile
+    {
+        String path;            // relative to the output directory, e.g. "js/audio.js"
+        MemoryBlock content;
+    };
+    
+    // The files making the generated page, as they are written to the output directory or served
+    // by the test server. Text files have "\r\n" line endings.
+    Array<OutputFile> getOutputFiles() const;
+    
+    // Audio files that are delivered under another name, e.g. after transcoding
+    void setRenamedAudioFiles (const StringPairArray& renamed);
+    
+    // When set, decodable audio is fetched from this bundle rather than file by file
+    void setAudioBundleUrl (const String& url) { audioBundleUrl = url; }
+    
+    // Leaves out the nodes that can't be heard nor used, see findLiveElements(). Enabled by default.
+    void setDeadNodeEliminationEnabled (bool shouldBeEnabled) { eliminateDeadNodes = shouldBeEnabled; }
+    
+    // Runs WebAudioGraphOptimizer on the graph before generating it. Disabled by default.
+    void setOptimizationEnabled (bool shouldBeEnabled) { optimizeGraph = shouldBeEnabled; }
+    
+    // Adds js/livereload.js to the page, which reloads the changed files when LocalServer pushes
+    // a new generation. Only meant for the browser test. Disabled by default.
+    void setLiveReloadEnabled (bool shouldBeEnabled) { liveReload = shouldBeEnabled; }
+    
+    // Once enabled, the declarations of the nodes and audio data are reused from one generation
+    // to the next without reading their options, until elementChanged() is called for them.
+    // Only meant for callers reporting every change to the graph's elements. Disabled by default.
+    void setElementChangeTrackingEnabled (bool shouldBeEnabled);
+    void elementChanged (int graphId) { fragmentCache.elementChanged (graphId); }
+    int64 getElementChangeCount() const { return fragmentCache.getChangeCount(); }
+    
 private:
     String getIndent (int indentLevel) const;
     
+    void findLiveElements();
+    bool isLive (const WebAudioGraphModel::Element& element) const;
+    
     String generateAudioContexts (int numIndents);
     String generateDynamicRoutes (int numIndents);
     String generateAudioData (int numIndents);
     String generateScriptBodies (int numIndents) const;
 
-    void declareButtons (String& buttonsScript, int indentLevelScript);
-    String getNodeDeclaration (const WebAudioNode* n, int numIndents) const;
-    String getConnectionDeclaration (const ConnectionInfo& info, int numIndents) const;
+    void declareButtons (OutputStream& buttonsScript, int indentLevelScript);
+    String getNodeDeclaration (const WebAudioGraphModel::Element& n, int numIndents) const;
+    String createNodeDeclaration (const WebAudioGraphModel::Element& n, const String& contextName, int numIndents) const;
+    String getConnectionDeclaration (const WebAudioGraphModel::Connection& info, int numIndents) const;
+    String createConnectionDeclaration (const WebAudioGraphModel::Connection& info,
+                                        const WebAudioGraphModel::Element* sourceComp,
+                                        const WebAudioGraphModel::Element* destComp,
+                                        int numIndents) const;
+    String getAudioDataDeclaration (const WebAudioGraphModel::Element& d, int numIndents) const;
+    String createAudioDataDeclaration (const WebAudioGraphModel::Element& d,
+                                       const Array<WebAudioGraphModel::Option>& opt,
+                                       int numIndents) const;
+    String getDeliveredUrl (const String& quotedUrl) const;
     String getPrivateMembersDeclaration (int numIndents) const;
     String getPreloadDeclaration (int numIndents) const;
     
-    String getHtmlPage (const String &pageName, String &controllersName);
+    String getHtmlPage (const String& pageName, const String& controllersName) const;
     String getPageTitle() const;
 
-    WebAudioGraphPanel& graph;
+    const WebAudioGraphModel* graph = nullptr;
     
     String libraryCode;
+    String htmlTemplate;
+    StringPairArray renamedAudioFiles;
+    String audioBundleUrl;
+    
+    bool eliminateDeadNodes = true;
+    bool liveReload = false;
+    
+    bool optimizeGraph = false;
+    WebAudioGraphModel optimizedGraph;
+    HashMap<int, bool> rewrittenElementIds;
+    bool tracksElementChanges = false;
+    HashMap<int, bool> liveElementIds;
     const String defaultContextName = "ctx";
+    const String audioDataContextName = "adCtx";
     String moduleName = "graph";
     String controllersDivName = "controllers";
     String htmlPage;
-    String outputScript;
-    StringArray privateMembers;
+    MemoryOutputStream scriptOutput;
+    // Names in declaration order, which can be looked up without scanning them
+    struct NameList
+    {
+        bool contains (const String& name) const    { return lookup.contains (name); }
+        
+        bool add (const String& name)
+        {
+            if (contains (name))
+                return false;
+            
+            lookup.set (name, true);
+            names.add (name);
+            return true;
+        }
+        
+        void clear()
+        {
+            names.clear();
+            lookup.clear();
+        }
+        
+        StringArray names;
+        HashMap<String, bool> lookup;
+    };
+    
+    NameList privateMembers;
     bool useAudioPredecoder;
     String preloadAudioContent;
     
@@ -66,8 +153,177 @@ private:
     
     OwnedArray<ButtonInfo> buttonInfos;
     
+    //==============================================================================
+    // Keeps the fragments generated between two calls to generate(). A key holds everything a
+    // fragment depends on, and is compared in full when a fragment is looked up. Fragments that
+    // aren't used during a generation pass are dropped at the end of it.
+    // The last fragment of each element is also kept by graph id: as long as the editor doesn't
+    // report a change to the element, it is reused without building the key of its options.
+    class FragmentCache
+    {
+    public:
+        struct Key
+        {
+            // Lengths are part of the material, so that different parts can't make the same key
+            Key& operator<< (const String& s)   { material << s.length() << ':' << s; return *this; }
+            Key& operator<< (const char* s)     { return operator<< (String (s)); }
+            Key& operator<< (int value)         { material << value << ';'; return *this; }
+            
+            String material;
+        };
+        
+        // The pass works on a model taken when getChangeCount() returned snapshotChangeCount,
+        // or on an up to date one when it is negative
+        void beginPass (int64 snapshotChangeCount)
+        {
+            const ScopedLock sl (lock);
+            previousFragments.swapWith (currentFragments);
+            currentFragments.clear();
+            passChangeCount = snapshotChangeCount < 0 ? changeCount : snapshotChangeCount;
+        }
+        
+        void endPass()
+        {
+            const ScopedLock sl (lock);
+            previousFragments.clear();
+        }
+        
+        // Can be called from several threads during a pass. Fragments are created outside of the lock.
+        template <typename FragmentCreator>
+        String get (const Key& key, FragmentCreator createFragment)
+        {
+            {
+                const ScopedLock sl (lock);
+                
+                if (currentFragments.contains (key.material))
+                    return currentFragments[key.material];
+                
+                if (previousFragments.contains (key.material))
+                {
+                    const String fragment (previousFragments[key.material]);
+                    currentFragments.set (key.material, fragment);
+                    return fragment;
+                }
+            }
+            
+            const String fragment (createFragment());
+            
+            const ScopedLock sl (lock);
+            currentFragments.set (key.material, fragment);
+            return fragment;
+        }
+        
+        // Returns the element's last fragment if it wasn't changed since and has the same
+        // identity (name, indentation...), otherwise creates it and keeps it for the element.
+        template <typename FragmentCreator>
+        String getForElement (int graphId, const Key& identity, FragmentCreator createFragment)
+        {
+            {
+                const ScopedLock sl (lock);
+                
+                if (elementFragments.contains (graphId))
+                {
+                    const ElementFragment& last = elementFragments.getReference (graphId);
+                    
+                    if (last.identity == identity.material)
+                        return last.fragment;
+                }
+            }
+            
+            const String fragment (createFragment());
+            
+            const ScopedLock sl (lock);
+            
+            // Not kept when the element changed after the pass' model was taken
+            if (lastChangeOfElement[graphId] <= passChangeCount)
+                elementFragments.set (graphId, { identity.material, fragment });
+            
+            return fragment;
+        }
+        
+        void elementChanged (int graphId)
+        {
+            const ScopedLock sl (lock);
+            elementFragments.remove (graphId);
+            lastChangeOfElement.set (graphId, ++changeCount);
+        }
+        
+        int64 getChangeCount() const
+        {
+            const ScopedLock sl (lock);
+            return changeCount;
+        }
+        
+        void forgetElements()
+        {
+            const ScopedLock sl (lock);
+            elementFragments.clear();
+        }
+        
+    private:
+        struct ElementFragment
+        {
+            String identity;
+            String fragment;
+        };
+        
+        HashMap<String, String> currentFragments;
+        HashMap<String, String> previousFragments;
+        HashMap<int, ElementFragment> elementFragments;
+        HashMap<int, int64> lastChangeOfElement;
+        int64 changeCount = 0;
+        int64 passChangeCount = 0;
+        CriticalSection lock;
+    };
+    
+    mutable FragmentCache fragmentCache;
+    
+    // Reuses the element's last fragment when its changes are tracked, see setElementChangeTrackingEnabled()
+    template <typename FragmentCreator>
+    String getElementFragment (const WebAudioGraphModel::Element& element, const FragmentCache::Key& identity,
+                               FragmentCreator createFragment) const;
+    
+    //==============================================================================
+    // Text in which node and connection declarations are only placeholders until render() is
+    // called, so that the declarations of independent contexts and routes can be created on
+    // several threads once their layout is known.
+    class DeferredOutput
+    {
+    public:
+        DeferredOutput& operator<< (const String& text)     { pendingText << text; return *this; }
+        DeferredOutput& operator<< (const NewLine&)         { pendingText << newLine; return *this; }
+        
+        void addNodeDeclaration (const WebAudioGraphModel::Element& node, int numIndents);
+        void addConnectionDeclaration (const WebAudioGraphModel::Connection& connection, int numIndents);
+        
+        // Thread-safe as long as the generator's graph doesn't change
+        String render (const WebAudioGraphGenerator& generator) const;
+        
+    private:
+        struct Part
+        {
+            String text;
+            const WebAudioGraphModel::Element* node;
+            const WebAudioGraphModel::Connection* connection;
+            int numIndents;
+        };
+        
+        void flushPendingText();
+        
+        Array<Part> parts;
+        String pendingText;
+    };
+    
+    // Renders the outputs on the thread pool, the results are in the same order as the outputs
+    StringArray renderInParallel (const Array<const DeferredOutput*>& outputs);
+    
+    ThreadPool threadPool;
+    
     const String audioContextHeader = "var AudioContext = window.AudioContext || window.webkitAudioContext;";
     const String indent = "   ";
     
+    enum { numCachedIndents = 16 };
+    StringArray indentTable;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WebAudioGraphGenerator)
 };
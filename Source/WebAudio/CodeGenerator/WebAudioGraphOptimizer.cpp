@@ -0,0 +1,355 @@
+#include "WebAudioGraphOptimizer.h"
+#include "HashMapHelpers.h"
+
+WebAudioGraphOptimizer::WebAudioGraphOptimizer (const WebAudioGraphModel& sourceModel) : source (sourceModel)
+{
+}
+
+int WebAudioGraphOptimizer::optimize (WebAudioGraphModel& result)
+{
+    elements.clearQuick();
+    connections.clearQuick();
+    connectionsOfNode.clear();
+    elementIndexForGraphId.clear();
+    removedIds.clear();
+    rewrittenIds.clearQuick();
+    namesUsedInCode.clear();
+    
+    for (int i = 0; i < source.getNumElements(); ++i)
+    {
+        elementIndexForGraphId.set (source.getElement (i).graphId, elements.size());
+        elements.add (source.getElement (i));
+    }
+    
+    for (auto& c : source.getConnections())
+        addConnection (c);
+    
+    source.findIdentifiersUsedInCode (namesUsedInCode);
+    
+    // Each rewrite may enable others (a folded chain can end up with a unity gain...)
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        
+        for (auto& e : elements)
+        {
+            if (removedIds.contains (e.graphId))
+                continue;
+            
+            if (isStaticGain (e))
+                changed = foldGainIntoNext (e) || removeUnityGain (e) || changed;
+        }
+        
+        changed = mergeConstantSources() || changed;
+    }
+    
+    result.clear();
+    result.setPageTitle (source.getPageTitle());
+    
+    for (auto& e : elements)
+        if (! removedIds.contains (e.graphId))
+            result.addElement (e);
+    
+    for (auto& c : connections)
+        if (hasConnection (c))
+            result.addConnection (c);
+    
+    return source.getNumElements() - result.getNumElements();
+}
+
+//==============================================================================
+WebAudioGraphModel::Element* WebAudioGraphOptimizer::findElement (int graphId)
+{
+    if (! elementIndexForGraphId.contains (graphId) || removedIds.contains (graphId))
+        return nullptr;
+    
+    return &elements.getReference (elementIndexForGraphId[graphId]);
+}
+
+const Array<WebAudioGraphModel::Connection>& WebAudioGraphOptimizer::getConnectionsOf (int graphId) const
+{
+    return HashMapHelpers::find (connectionsOfNode, graphId);
+}
+
+bool WebAudioGraphOptimizer::hasConnection (const Connection& c) const
+{
+    return getConnectionsOf (c.sourceId).contains (c);
+}
+
+bool WebAudioGraphOptimizer::addConnection (const Connection& c)
+{
+    if (hasConnection (c))
+        return false;
+    
+    connections.add (c);
+    connectionsOfNode.getReference (c.sourceId).add (c);
+    
+    if (c.destId != c.sourceId)
+        connectionsOfNode.getReference (c.destId).add (c);
+    
+    return true;
+}
+
+// Outputs are on the bottom, audio inputs on top and params on the left,
+// as in WebAudioGraphGenerator::createConnectionDeclaration()
+bool WebAudioGraphOptimizer::isOutputOf (const Connection& c, const Element& node)
+{
+    return c.sourceId == node.graphId && c.sourcePlacement == WebAudioGraphModel::pinOnBottom;
+}
+
+bool WebAudioGraphOptimizer::isAudioInputOf (const Connection& c, const Element& node)
+{
+    return c.destId == node.graphId
+        && c.destPlacement == WebAudioGraphModel::pinOnTop
+        && c.sourcePlacement == WebAudioGraphModel::pinOnBottom;
+}
+
+bool WebAudioGraphOptimizer::isStaticGain (const Element& node) const
+{
+    if (node.interfaceName != "GainNode" || ! node.hasInstance
+        || node.name.contains (".") || namesUsedInCode.contains (node.name))
+        return false;
+    
+    // Channel options change the mixing: only nodes using the defaults can be removed
+    for (auto& o : node.options)
+        if (o.name != "gain" && o.value.isNotEmpty())
+            return false;
+    
+    double value;
+    
+    if (! getStaticValue (node, "gain", 1.0, value))
+        return false;
+    
+    // No param automation through connections and no message to this node
+    for (auto& c : getConnectionsOf (node.graphId))
+        if (! (isOutputOf (c, node) || isAudioInputOf (c, node)))
+            return false;
+    
+    return true;
+}
+
+bool WebAudioGraphOptimizer::isInSameContainer (const Element& node, const Connection& c)
+{
+    auto other = findElement (c.sourceId == node.graphId ? c.destId : c.sourceId);
+    
+    return other != nullptr
+        && other->contextId == node.contextId
+        && other->dynamicRouteIds == node.dynamicRouteIds;
+}
+
+bool WebAudioGraphOptimizer::getStaticValue (const Element& node, const String& optionName, double defaultValue, double& value)
+{
+    for (auto& o : node.options)
+    {
+        if (o.name != optionName)
+            continue;
+        
+        const String v (o.value.trim());
+        
+        // Expressions and variables can't be known before running the page
+        if (v.isNotEmpty() && ! v.containsOnly ("0123456789.-+eE"))
+            return false;
+        
+        value = v.isEmpty() ? defaultValue : v.getDoubleValue();
+        return true;
+    }
+    
+    value = defaultValue;
+    return true;
+}
+
+void WebAudioGraphOptimizer::setOption (Element& node, const String& optionName, const String& value)
+{
+    for (auto& o : node.options)
+    {
+        if (o.name == optionName)
+        {
+            o.value = value;
+            return;
+        }
+    }
+    
+    node.options.add ({ optionName, value });
+}
+
+//==============================================================================
+bool WebAudioGraphOptimizer::foldGainIntoNext (Element& gain)
+{
+    const auto gainConnections = getConnectionsOf (gain.graphId);
+    
+    Array<Connection> inputs, outputs;
+    
+    for (auto& c : gainConnections)
+        (c.destId == gain.graphId ? inputs : outputs).add (c);
+    
+    // The gain only feeds another static gain's input, which is only fed by it
+    if (outputs.size() != 1 || ! isInSameContainer (gain, outputs.getFirst())
+        || outputs.getFirst().destPlacement != WebAudioGraphModel::pinOnTop)
+        return false;
+    
+    auto next = findElement (outputs.getFirst().destId);
+    
+    if (next == nullptr || next == &gain || ! isStaticGain (*next))
+        return false;
+    
+    for (auto& c : getConnectionsOf (next->graphId))
+        if (c.destId == next->graphId && c.sourceId != gain.graphId)
+            return false;
+    
+    double gainValue, nextValue;
+    getStaticValue (gain, "gain", 1.0, gainValue);
+    getStaticValue (*next, "gain", 1.0, nextValue);
+    
+    // A missing gain option is the default 1, the folded value must be added then
+    setOption (*next, "gain", String (gainValue * nextValue));
+    rewrittenIds.addIfNotAlreadyThere (next->graphId);
+    
+    for (auto& c : inputs)
+        addConnection ({ c.sourceId, c.sourceIndex, c.sourcePlacement, next->graphId, 0, WebAudioGraphModel::pinOnTop });
+    
+    removeNode (gain);
+    return true;
+}
+
+bool WebAudioGraphOptimizer::removeUnityGain (Element& gain)
+{
+    double value;
+    getStaticValue (gain, "gain", 1.0, value);
+    
+    if (value != 1.0)
+        return false;
+    
+    Array<Connection> inputs, outputs;
+    
+    for (auto& c : getConnectionsOf (gain.graphId))
+    {
+        if (! isInSameContainer (gain, c))
+            return false;
+        
+        (c.destId == gain.graphId ? inputs : outputs).add (c);
+    }
+    
+    Array<Connection> bypasses;
+    
+    for (auto& in : inputs)
+    {
+        for (auto& out : outputs)
+        {
+            const Connection bypass { in.sourceId, in.sourceIndex, in.sourcePlacement,
+                                      out.destId, out.destIndex, out.destPlacement };
+            
+            // An existing connection would then carry the signal twice
+            if (hasConnection (bypass) || bypasses.contains (bypass))
+                return false;
+            
+            bypasses.add (bypass);
+        }
+    }
+    
+    removeNode (gain);
+    
+    for (auto& c : bypasses)
+        addConnection (c);
+    
+    return true;
+}
+
+bool WebAudioGraphOptimizer::mergeConstantSources()
+{
+    bool merged = false;
+    
+    // Sources with the same options, container and triggers share the first one's key
+    HashMap<String, int> firstSourceWithKey;
+    
+    for (auto& e : elements)
+    {
+        if (removedIds.contains (e.graphId) || e.interfaceName != "ConstantSourceNode"
+            || ! e.hasInstance || e.name.contains (".") || namesUsedInCode.contains (e.name))
+            continue;
+        
+        const auto nodeConnections = getConnectionsOf (e.graphId);
+        
+        String key (String (e.contextId) + "|");
+        
+        for (auto id : e.dynamicRouteIds)
+            key << id << ",";
+        
+        for (auto& o : e.options)
+            key << "|" << o.name << "=" << o.value;
+        
+        SortedSet<int> triggers;
+        bool hasParamInput = false;
+        
+        for (auto& c : nodeConnections)
+        {
+            if (isOutputOf (c, e))
+                continue;
+            
+            auto other = findElement (c.sourceId == e.graphId ? c.destId : c.sourceId);
+            
+            if (other != nullptr && other->isMessage())
+                triggers.add (other->graphId);
+            else
+                hasParamInput = true;
+        }
+        
+        if (hasParamInput)
+            continue;
+        
+        key << "|";
+        
+        for (auto id : triggers)
+            key << id << ",";
+        
+        if (! firstSourceWithKey.contains (key))
+        {
+            firstSourceWithKey.set (key, e.graphId);
+            continue;
+        }
+        
+        auto first = findElement (firstSourceWithKey[key]);
+        Array<Connection> outputs;
+        bool canMerge = true;
+        
+        for (auto& c : nodeConnections)
+        {
+            if (! isOutputOf (c, e))
+                continue;
+            
+            const Connection moved { first->graphId, c.sourceIndex, c.sourcePlacement,
+                                     c.destId, c.destIndex, c.destPlacement };
+            
+            canMerge = canMerge && ! hasConnection (moved) && ! outputs.contains (moved);
+            outputs.add (moved);
+        }
+        
+        if (! canMerge)
+            continue;
+        
+        // The triggers already target the first source
+        removeNode (e);
+        
+        for (auto& c : outputs)
+            addConnection (c);
+        
+        merged = true;
+    }
+    
+    return merged;
+}
+
+void WebAudioGraphOptimizer::removeNode (Element& node)
+{
+    removedIds.set (node.graphId, true);
+    
+    // The log of connections is filtered by optimize(), only the index needs updating
+    for (auto& c : Array<Connection> (getConnectionsOf (node.graphId)))
+    {
+        const int otherId = c.sourceId == node.graphId ? c.destId : c.sourceId;
+        
+        if (otherId != node.graphId)
+            connectionsOfNode.getReference (otherId).removeFirstMatchingValue (c);
+    }
+    
+    connectionsOfNode.remove (node.graphId);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "WebAudioGraphModel.h"
+
+// Rewrites a graph into an equivalent one with fewer native nodes:
+// - chains of GainNodes with static gains are folded into a single node
+// - GainNodes with a unity gain are removed
+// - ConstantSourceNodes with the same options and triggers are merged
+// Only the nodes whose params aren't driven by connections, messages or scripts are touched.
+// StereoPannerNodes are kept even when centred: they spread a mono input over both channels,
+// and the channel count of their input can't be known before running the page.
+class WebAudioGraphOptimizer
+{
+public:
+    WebAudioGraphOptimizer (const WebAudioGraphModel& source);
+    
+    // Fills result with the optimized graph. Returns the number of nodes that were removed.
+    int optimize (WebAudioGraphModel& result);
+    
+    // The kept elements whose options were changed by the last optimize()
+    const Array<int>& getRewrittenIds() const { return rewrittenIds; }
+    
+private:
+    using Element = WebAudioGraphModel::Element;
+    using Connection = WebAudioGraphModel::Connection;
+    
+    Element* findElement (int graphId);
+    
+    // Connections are indexed by the ids of both their ends
+    const Array<Connection>& getConnectionsOf (int graphId) const;
+    bool hasConnection (const Connection& c) const;
+    bool addConnection (const Connection& c);
+    
+    static bool isOutputOf (const Connection& c, const Element& node);
+    static bool isAudioInputOf (const Connection& c, const Element& node);
+    bool isStaticGain (const Element& node) const;
+    bool isInSameContainer (const Element& node, const Connection& c);
+    
+    static bool getStaticValue (const Element& node, const String& optionName, double defaultValue, double& value);
+    static void setOption (Element& node, const String& optionName, const String& value);
+    
+    bool foldGainIntoNext (Element& gain);
+    bool removeUnityGain (Element& gain);
+    bool mergeConstantSources();
+    
+    void removeNode (Element& node);
+    
+    const WebAudioGraphModel& source;
+    
+    Array<Element> elements;
+    Array<Connection> connections;          // every connection ever added, in order
+    HashMap<int, Array<Connection>> connectionsOfNode;
+    HashMap<int, int> elementIndexForGraphId;
+    HashMap<int, bool> removedIds;
+    Array<int> rewrittenIds;
+    HashMap<String, bool> namesUsedInCode;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WebAudioGraphOptimizer)
+};
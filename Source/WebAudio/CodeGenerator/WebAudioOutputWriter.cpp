@@ -0,0 +1,354 @@
+#include "WebAudioOutputWriter.h"
+#include "WebAudioGraphCodeGenerator.h"
+#include "AudioTranscoder.h"
+#include "ParallelJobs.h"
+
+WebAudioOutputWriter::WebAudioOutputWriter (const File& outputDirectory) : outputDir (outputDirectory)
+{
+}
+
+bool WebAudioOutputWriter::prepareDirectories()
+{
+    for (auto dir : { outputDir, outputDir.getChildFile ("js"), outputDir.getChildFile ("data") })
+        if (! dir.exists() && dir.createDirectory().failed())
+            return false;
+    
+    return true;
+}
+
+WebAudioOutputWriter::SyncResult WebAudioOutputWriter::syncAudioFiles (const Array<AudioFile>& files,
+                                                                       const AudioTranscoder* transcoder,
+                                                                       bool packIntoBundle,
+                                                                       bool deleteOrphans)
+{
+    SyncResult result;
+    const auto dataDir = outputDir.getChildFile ("data");
+    const bool transcodes = transcoder != nullptr && transcoder->getSettings().isEnabled();
+    
+    Array<AudioFile> filesToDeliver;
+    StringArray originalNames;
+    StringArray expectedNames;
+    
+    for (auto& f : files)
+    {
+        bool isDuplicate = false;
+        
+        for (auto& other : filesToDeliver)
+            isDuplicate = isDuplicate || other.outputName == f.outputName;
+        
+        if (isDuplicate)
+            continue;
+        
+        if (f.source.existsAsFile())
+        {
+            filesToDeliver.add (f);
+            originalNames.add (f.outputName);
+            continue;
+        }
+        
+        // A source that went missing (unmounted drive, file being replaced...) keeps its last delivered copy
+        ++result.numMissing;
+        expectedNames.add (f.outputName);
+        
+        if (transcodes)
+            expectedNames.add (transcoder->getTranscodedName (f.outputName));
+    }
+    
+    // Encodes the sources that aren't in the transcoder's cache yet
+    if (transcodes)
+    {
+        Array<File> transcoded;
+        transcoded.resize (filesToDeliver.size());
+        
+        ThreadPool pool (jlimit (1, ParallelJobs::getDefaultNumThreads(), filesToDeliver.size()));
+        
+        ParallelJobs::run (pool, filesToDeliver.size(), [&] (int i)
+        {
+            transcoded.getReference (i) = transcoder->getTranscodedFile (filesToDeliver.getReference (i).source);
+        });
+        
+        for (int i = 0; i < filesToDeliver.size(); ++i)
+        {
+            auto& f = filesToDeliver.getReference (i);
+            
+            // A file that can't be decoded or encoded is delivered as is
+            if (transcoded[i] != File())
+                f = { transcoded[i], transcoder->getTranscodedName (f.outputName) };
+            else
+                result.untranscodedFiles.add (f.outputName);
+        }
+    }
+    
+    // Transcoding can give several files the same name (kick.wav and kick.aif both become kick.ogg):
+    // the later ones are delivered under a numbered name. Names are compared ignoring case,
+    // as they would be by some file systems.
+    HashMap<String, bool> namesInUse;
+    
+    for (auto& f : filesToDeliver)
+        namesInUse.set (f.outputName.toLowerCase(), true);
+    
+    HashMap<String, bool> deliveredNames;
+    
+    for (int i = 0; i < filesToDeliver.size(); ++i)
+    {
+        auto& f = filesToDeliver.getReference (i);
+        
+        if (deliveredNames.contains (f.outputName.toLowerCase()))
+        {
+            const auto file = File::createFileWithoutCheckingPath (f.outputName);
+            String uniqueName;
+            
+            for (int suffix = 2; uniqueName.isEmpty() || namesInUse.contains (uniqueName.toLowerCase()); ++suffix)
+                uniqueName = file.getFileNameWithoutExtension() + "_" + String (suffix) + file.getFileExtension();
+            
+            result.nameCollisions.add (originalNames[i] + " would have been delivered as " + f.outputName
+                                       + ", it is delivered as " + uniqueName);
+            
+            namesInUse.set (uniqueName.toLowerCase(), true);
+            f.outputName = uniqueName;
+        }
+        
+        deliveredNames.set (f.outputName.toLowerCase(), true);
+        
+        if (f.outputName != originalNames[i])
+            result.renamedFiles.set (originalNames[i], f.outputName);
+    }
+    
+    Array<AudioFile> filesToCopy;
+    
+    for (auto& f : filesToDeliver)
+    {
+        expectedNames.add (f.outputName);
+        
+        if (isUpToDate (f.source, dataDir.getChildFile (f.outputName)))
+            ++result.numUpToDate;
+        else
+            filesToCopy.add (f);
+    }
+    
+    Array<bool> copied;
+    copied.resize (filesToCopy.size());
+    
+    if (! filesToCopy.isEmpty())
+    {
+        ThreadPool pool (jlimit (1, ParallelJobs::getDefaultNumThreads(), filesToCopy.size()));
+        
+        ParallelJobs::run (pool, filesToCopy.size(), [&] (int i)
+        {
+            auto& f = filesToCopy.getReference (i);
+            copied.getReference (i) = copyAtomically (f.source, dataDir.getChildFile (f.outputName));
+        });
+    }
+    
+    for (auto success : copied)
+    {
+        if (success)
+            ++result.numCopied;
+        else
+            ++result.numFailed;
+    }
+    
+    if (packIntoBundle)
+    {
+        const auto bundleFile = dataDir.getChildFile (getAudioBundleUrl().fromLastOccurrenceOf ("/", false, false));
+        expectedNames.add (bundleFile.getFileName());
+        
+        // When nothing was copied, the files' content is the one the bundle was last written with
+        const bool filesUnchanged = result.numCopied == 0 && result.numFailed == 0;
+        
+        if (! writeAudioBundle (bundleFile, filesToDeliver, filesUnchanged, result.bundleWritten))
+            ++result.numFailed;
+    }
+    
+    if (! deleteOrphans)
+        return result;
+    
+    // Orphans: whatever else is in data/ comes from files that were removed or renamed
+    for (auto& f : dataDir.findChildFiles (File::findFiles | File::ignoreHiddenFiles, false))
+        if (! expectedNames.contains (f.getFileName()) && f.deleteFile())
+            ++result.numDeleted;
+    
+    return result;
+}
+
+bool WebAudioOutputWriter::writeAudioBundle (const File& bundleFile, const Array<AudioFile>& files,
+                                             bool filesUnchanged, bool& written)
+{
+    written = false;
+    
+    // The index gives each file's url, as used by the generated code, and its place in the data
+    Array<var> index;
+    int64 offset = 0;
+    
+    for (auto& f : files)
+    {
+        const int64 size = f.source.getSize();
+        
+        DynamicObject::Ptr entry (new DynamicObject());
+        entry->setProperty ("url", "/data/" + f.outputName);
+        entry->setProperty ("offset", offset);
+        entry->setProperty ("size", size);
+        index.add (var (entry.get()));
+        
+        offset += size;
+    }
+    
+    MemoryOutputStream indexData;
+    indexData << JSON::toString (var (index), true);
+    
+    // The same files in the same order give the same index: the bundle is then left as it is
+    if (filesUnchanged && hasBundleIndex (bundleFile, indexData.getMemoryBlock(), offset))
+        return true;
+    
+    // A bundle that couldn't be updated is removed, so that it isn't taken as up to date next time
+    TemporaryFile temp (bundleFile);
+    
+    {
+        FileOutputStream fos (temp.getFile());
+        
+        if (! fos.openedOk())
+        {
+            bundleFile.deleteFile();
+            return false;
+        }
+        
+        fos.write ("WAVB", 4);
+        fos.writeInt ((int) indexData.getDataSize());
+        fos << indexData;
+        
+        for (auto& f : files)
+        {
+            FileInputStream fis (f.source);
+            
+            if (! fis.openedOk() || fos.writeFromInputStream (fis, -1) != f.source.getSize())
+            {
+                bundleFile.deleteFile();
+                return false;
+            }
+        }
+        
+        fos.flush();
+        
+        if (fos.getStatus().failed())
+        {
+            bundleFile.deleteFile();
+            return false;
+        }
+    }
+    
+    written = temp.overwriteTargetFileWithTemporary();
+    
+    if (! written)
+        bundleFile.deleteFile();
+    
+    return written;
+}
+
+bool WebAudioOutputWriter::hasBundleIndex (const File& bundleFile, const MemoryBlock& indexData, int64 dataSize)
+{
+    // Only the header is read: "WAVB", the index size, then the index
+    if (bundleFile.getSize() != 8 + (int64) indexData.getSize() + dataSize)
+        return false;
+    
+    FileInputStream fis (bundleFile);
+    char magic[4];
+    
+    if (! fis.openedOk() || fis.read (magic, 4) != 4 || memcmp (magic, "WAVB", 4) != 0
+        || fis.readInt() != (int) indexData.getSize())
+        return false;
+    
+    MemoryBlock existingIndex;
+    fis.readIntoMemoryBlock (existingIndex, (ssize_t) indexData.getSize());
+    
+    return existingIndex == indexData;
+}
+
+bool WebAudioOutputWriter::isUpToDate (const File& source, const File& dest)
+{
+    if (! dest.existsAsFile() || dest.getSize() != source.getSize())
+        return false;
+    
+    // Copies are given their source's modification time, so an equal time means nothing changed.
+    // Otherwise the content decides, and the time is fixed so that it won't be hashed again.
+    if (dest.getLastModificationTime() == source.getLastModificationTime())
+        return true;
+    
+    if (! dest.hasIdenticalContentTo (source))
+        return false;
+    
+    dest.setLastModificationTime (source.getLastModificationTime());
+    return true;
+}
+
+bool WebAudioOutputWriter::copyAtomically (const File& source, const File& dest)
+{
+    TemporaryFile temp (dest);
+    
+    if (! source.copyFileTo (temp.getFile()))
+        return false;
+    
+    temp.getFile().setLastModificationTime (source.getLastModificationTime());
+    
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+int WebAudioOutputWriter::writeGeneratedFiles (const WebAudioGraphGenerator& generator)
+{
+    int numWritten = 0;
+    
+    for (auto& f : generator.getOutputFiles())
+        numWritten += writeIfChanged (outputDir.getChildFile (f.path), f.content) ? 1 : 0;
+    
+    return numWritten;
+}
+
+bool WebAudioOutputWriter::writeIfChanged (const File& f, const MemoryBlock& content)
+{
+    if (hasSameContent (f, content))
+        return false;
+    
+    // Written next to the target then renamed over it, so that readers never see a partial file
+    TemporaryFile temp (f);
+    
+    {
+        FileOutputStream fos (temp.getFile());
+        
+        if (! fos.openedOk() || ! fos.write (content.getData(), content.getSize()))
+            return false;
+        
+        fos.flush();
+        
+        if (fos.getStatus().failed())
+            return false;
+    }
+    
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+bool WebAudioOutputWriter::hasSameContent (const File& f, const MemoryBlock& content)
+{
+    if (! f.existsAsFile() || f.getSize() != (int64) content.getSize())
+        return false;
+    
+    FileInputStream fis (f);
+    
+    if (! fis.openedOk())
+        return false;
+    
+    // Compared as it is read, stopping at the first difference
+    HeapBlock<char> buffer (comparisonChunkSize);
+    auto expected = static_cast<const char*> (content.getData());
+    
+    for (size_t pos = 0; pos < content.getSize();)
+    {
+        const int numToRead = (int) jmin ((size_t) comparisonChunkSize, content.getSize() - pos);
+        
+        if (fis.read (buffer, numToRead) != numToRead || memcmp (buffer, expected + pos, (size_t) numToRead) != 0)
+            return false;
+        
+        pos += (size_t) numToRead;
+    }
+    
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+class WebAudioGraphGenerator;
+class AudioTranscoder;
+
+// Writes a generated project into its output directory (index.html, style.css, js/ and data/).
+// Shared by the editor and the command-line generator.
+class WebAudioOutputWriter
+{
+public:
+    struct AudioFile
+    {
+        File source;
+        String outputName;
+    };
+    
+    struct SyncResult
+    {
+        int numCopied = 0;
+        int numUpToDate = 0;
+        int numDeleted = 0;
+        int numFailed = 0;
+        int numMissing = 0;         // sources that can't be found, their delivered copy is kept
+        bool bundleWritten = false;
+        
+        // Output names of the files that were renamed by the transcoder, and their new name
+        StringPairArray renamedFiles;
+        
+        // Files that got a numbered name because their transcoded name was already used
+        StringArray nameCollisions;
+        
+        // Files that couldn't be transcoded, which are delivered as they are
+        StringArray untranscodedFiles;
+    };
+    
+    WebAudioOutputWriter (const File& outputDirectory);
+    
+    const File& getOutputDirectory() const { return outputDir; }
+    
+    bool prepareDirectories();
+    
+    // Makes data/ an exact copy of the given files: changed files are copied in parallel,
+    // up-to-date ones are left alone and files that aren't in the list anymore are deleted.
+    // With a transcoder, the transcoded files are delivered instead of the sources.
+    // With packIntoBundle, the delivered files are also packed into data/audio.bundle so that
+    // pages can fetch them all at once (see AudioBundle in wave.js). The files are still
+    // delivered one by one: audio elements stream their url, and DecodableAudio falls back
+    // to fetching its url when the bundle can't be loaded.
+    // Pass false for deleteOrphans when the list may be incomplete, nothing is deleted then.
+    SyncResult syncAudioFiles (const Array<AudioFile>& files,
+                               const AudioTranscoder* transcoder = nullptr,
+                               bool packIntoBundle = false,
+                               bool deleteOrphans = true);
+    
+    // The url a generated page uses to fetch the bundle
+    static String getAudioBundleUrl() { return "/data/audio.bundle"; }
+    
+    // Only the files whose content changed are written, so that unchanged files keep their
+    // modification time. Returns the number of files actually written.
+    int writeGeneratedFiles (const WebAudioGraphGenerator& generator);
+    
+private:
+    static bool writeIfChanged (const File& f, const MemoryBlock& content);
+    static bool hasSameContent (const File& f, const MemoryBlock& content);
+    static bool isUpToDate (const File& source, const File& dest);
+    static bool copyAtomically (const File& source, const File& dest);
+    static bool writeAudioBundle (const File& bundleFile, const Array<AudioFile>& files,
+                                  bool filesUnchanged, bool& written);
+    static bool hasBundleIndex (const File& bundleFile, const MemoryBlock& indexData, int64 dataSize);
+    
+    const File outputDir;
+    
+    enum { comparisonChunkSize = 65536 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WebAudioOutputWriter)
+};
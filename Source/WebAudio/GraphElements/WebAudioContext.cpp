@@ -136,31 +136,21 @@ String WebAudioContext::getValidName (String newName)
     
     bool nameIsAlreadyTaken = false;
     
-    for (auto emb : getParentGraph()->getEmbeddedComponents())
+    for (auto emb : parentPanel.getAllElementsWithName (newName))
     {
         if (auto ctx = dynamic_cast<WebAudioContext*>(emb))
         {
-            if (ctx->getPublicName() == newName && ctx != this && ctx->getInterfaceName() != getInterfaceName())
+            if (ctx != this && ctx->getInterfaceName() != getInterfaceName())
             {
                 nameIsAlreadyTaken = true;
                 break;
             }
         }
-        else if (auto node = dynamic_cast<WebAudioNode*>(emb))
+        else if (dynamic_cast<WebAudioNode*>(emb) != nullptr
+                 || dynamic_cast<WebAudioDynamicRoute*>(emb) != nullptr)
         {
-            if (node->getPublicName() == newName)
-            {
-                nameIsAlreadyTaken = true;
-                break;
-            }
-        }
-        else if (auto func = dynamic_cast<WebAudioDynamicRoute*>(emb))
-        {
-            if (func->getPublicName() == newName)
-            {
-                nameIsAlreadyTaken = true;
-                break;
-            }
+            nameIsAlreadyTaken = true;
+            break;
         }
     }
     
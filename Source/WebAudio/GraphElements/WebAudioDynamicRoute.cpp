@@ -89,21 +89,20 @@ String WebAudioDynamicRoute::getValidName (String newName)
     
     bool nameIsAlreadyTaken = false;
     
-    for (auto emb : getParentGraph()->getEmbeddedComponents())
+    for (auto emb : parentPanel.getAllElementsWithName (newName))
     {
         if (emb == this)
             continue;
         
         if (auto dr = dynamic_cast<WebAudioDynamicRoute*>(emb))
         {
-            if (dr->getPublicName() == newName &&
-                dr->getInterfaceName() != getInterfaceName())
+            if (dr->getInterfaceName() != getInterfaceName())
             {
                 nameIsAlreadyTaken = true;
                 break;
             }
         }
-        else if (emb->getPublicName() == newName)
+        else
         {
             nameIsAlreadyTaken = true;
             break;
@@ -127,12 +126,12 @@ void WebAudioDynamicRoute::checkContainers (bool useHighlight)
 {
     const auto centre = getBounds().getCentre();
     
-    for (auto cont : parentPanel.getContainers())
+    for (auto cont : parentPanel.getContainersToCheck (this, centre))
     {
         if (cont == this)
             continue;
         
-        if (auto ctx = dynamic_cast<WebAudioContext*> (cont.get()))
+        if (auto ctx = dynamic_cast<WebAudioContext*> (cont))
         {
             if (ctx->getBounds().contains (centre))
             {
@@ -244,9 +244,22 @@ void WebAudioInspectableElement::setInstance (WebAudioNodeInstance* newInstance)
     
     instance = newInstance;
     
+    contentChanged();
     refreshOptionsTree();
 }
 
+void WebAudioInspectableElement::instanceOptionsChanged()
+{
+    contentChanged();
+    refreshOptionsTree();
+}
+
+void WebAudioInspectableElement::contentChanged()
+{
+    if (embeddedComponent != nullptr)
+        parentPanel.elementChanged (embeddedComponent->getGraphId());
+}
+
 Array<Descriptor::Method> WebAudioInspectableElement::getAllMethods() const
 {
     SharedResourcePointer<WebAudioDictionary> dict;
@@ -291,6 +304,24 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this); }
+    
+    UndoableAction* createCoalescedAction (UndoableAction* nextAction) override
+    {
+        // Consecutive resizes of the same element only need the first and last bounds
+        if (auto next = dynamic_cast<UndoableBoundsSetter*> (nextAction))
+        {
+            if (next->persistantRef == persistantRef)
+            {
+                auto coalesced = new UndoableBoundsSetter (persistantRef.get(), next->newBounds, oldBounds);
+                coalesced->shouldActuallyPerform = true;
+                return coalesced;
+            }
+        }
+        
+        return nullptr;
+    }
+    
 private:
     void setBounds (juce::Rectangle<int> newBounds)
     {
@@ -309,7 +340,7 @@ private:
         }
         
         if (auto cont = dynamic_cast<WebAudioContainer*>(persistantRef.get()))
-            cont->getWebAudioGraph().containerMoved();
+            cont->getWebAudioGraph().containerMoved (cont);
         
         if (auto graph = persistantRef->getParentGraph())
             graph->adaptSizeToContent();
@@ -332,8 +363,7 @@ void WebAudioEmbedded::CustomResizableBorder::mouseDown (const MouseEvent& e)
     
     previousBounds = owner.getBounds();
     
-    auto &undoManager = owner.parentPanel.getUndoManager();
-    undoManager.beginNewTransaction();
+    owner.getWebAudioGraph().beginCoalescedTransaction ("Resize " + String (owner.getGraphId()));
 }
 
 void WebAudioEmbedded::CustomResizableBorder::mouseUp (const MouseEvent& e)
@@ -443,6 +473,24 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this); }
+    
+    UndoableAction* createCoalescedAction (UndoableAction* nextAction) override
+    {
+        // Consecutive moves of the same element only need the first and last positions
+        if (auto next = dynamic_cast<UndoablePositionSetter*> (nextAction))
+        {
+            if (next->persistantRef == persistantRef)
+            {
+                auto coalesced = new UndoablePositionSetter (persistantRef, next->newPos, oldPos);
+                coalesced->shouldReallyPerform = true;
+                return coalesced;
+            }
+        }
+        
+        return nullptr;
+    }
+    
 private:
     void moveTo (Point<int> newPosition)
     {
@@ -459,7 +507,7 @@ private:
         }
             
         if (auto cont = dynamic_cast<WebAudioContainer*>(persistantRef.get()))
-            cont->getWebAudioGraph().containerMoved();
+            cont->getWebAudioGraph().containerMoved (cont);
         
         if (auto graph = persistantRef->getParentGraph())
             graph->adaptSizeToContent();
@@ -481,9 +529,8 @@ void WebAudioEmbedded::mouseUp (const MouseEvent &e)
     if (e.mouseWasClicked() && e.getNumberOfClicks() == 2)
         showNameEditor();
     
-    for (auto cont : parentPanel.getContainers())
-        if (cont->getContent().contains (this))
-            cont->setHighlighted (false);
+    for (auto cont : parentPanel.getAllContainersContaining (this))
+        cont->setHighlighted (false);
 }
 
 void WebAudioEmbedded::wasDragged (const MouseEvent &e, bool dragIsOver, bool isUniqueSelection)
@@ -528,6 +575,8 @@ void WebAudioEmbedded::inspectablePropertyChanged (ValueTree &tree, const Identi
 {
     if (tree.getType() == Identifier("PROPERTY"))
     {
+        contentChanged();
+        
         const auto propName = tree["name"];
         const auto value = tree["value"];
         
@@ -619,8 +668,12 @@ void WebAudioEmbedded::labelTextChanged (Label* labelThatHasChanged)
 
 void WebAudioEmbedded::setPublicName (String newName)
 {
+    const String oldName (getPublicName());
     GraphEmbeddedComponent::setPublicName (newName);
     
+    if (oldName != newName)
+        parentPanel.elementNameChanged (this, oldName);
+    
     setPropertyValue (nameLabel, newName, nullptr);
     
     if (inspectableProperties.isValid())
@@ -639,9 +692,11 @@ void WebAudioEmbedded::checkContainers (bool useHighlight)
     
     bool shouldRefreshNavigable = false;
     
-    for (auto cont : parentPanel.getContainers())
+    const auto currentContainers = parentPanel.getAllContainersContaining (this);
+    
+    for (auto cont : parentPanel.getContainersToCheck (this, centre))
     {
-        const bool isAlreadyContained = cont->getContent().contains (this);
+        const bool isAlreadyContained = currentContainers.contains (cont);
         
         if (cont->getBounds().contains (centre))
         {
@@ -711,22 +766,16 @@ String WebAudioEmbedded::getValidName (String wantedName)
 
 bool WebAudioEmbedded::nameIsAlreadyTaken (String name)
 {
-    for (auto emb : getParentGraph()->getEmbeddedComponents())
+    for (auto emb : parentPanel.getAllElementsWithName (name))
     {
         if (emb == this)
             continue;
         
-        if (emb->getPublicName() == name)
-        {
-            if (emb->getUICompTypeName() != getUICompTypeName())
-                return true;
+        if (emb->getUICompTypeName() != getUICompTypeName())
+            return true;
         
-            if (auto webEmb = dynamic_cast<WebAudioEmbedded*> (emb))
-            {
-                if (webEmb->getInterfaceName() != getInterfaceName())
-                    return true;
-            }
-        }
+        if (emb->getInterfaceName() != getInterfaceName())
+            return true;
     }
     
     return false;
@@ -928,9 +977,8 @@ void WebAudioFoldable::mouseUp (const MouseEvent &e)
     }
     
     // Remove containers highlight
-    for (auto cont : parentPanel.getContainers())
-        if (cont->getContent().contains (this))
-            cont->setHighlighted (false);
+    for (auto cont : parentPanel.getAllContainersContaining (this))
+        cont->setHighlighted (false);
 }
 
 void WebAudioFoldable::paintUI (Graphics &g, juce::Rectangle<int> contentBounds)
@@ -1209,6 +1257,18 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this) + (int) (newValue.getNumBytesAsUTF8() + oldValue.getNumBytesAsUTF8()); }
+    
+    UndoableAction* createCoalescedAction (UndoableAction* nextAction) override
+    {
+        // Consecutive edits of the same option only need the first and last values
+        if (auto next = dynamic_cast<UndoableOptionSetter*> (nextAction))
+            if (next->persistantRef == persistantRef && next->itemComp == itemComp)
+                return new UndoableOptionSetter (dynamic_cast<WebAudioFoldable*> (persistantRef.get()), itemComp, next->newValue, oldValue);
+        
+        return nullptr;
+    }
+    
 private:
     WebAudioEmbedded::Ptr persistantRef;
     PropertyItemComponent* itemComp;
@@ -1219,9 +1279,8 @@ private:
 
 void WebAudioFoldable::OptionsPropertyTree::propertyItemValueChanged (PropertyItemComponent* comp, String newValue, String oldValue)
 {
-    auto &um = owner.parentPanel.getUndoManager();
-    um.beginNewTransaction();
-    um.perform (new UndoableOptionSetter (&owner, comp, newValue, oldValue));
+    owner.getWebAudioGraph().beginCoalescedTransaction ("Option " + String (owner.getGraphId()) + " " + comp->getPropertyName());
+    owner.parentPanel.getUndoManager().perform (new UndoableOptionSetter (&owner, comp, newValue, oldValue));
 }
 
 //==============================================================================
@@ -1246,19 +1305,28 @@ Array<WeakReference<NavigationPanel::Navigable>> WebAudioContainer::getSubNaviga
 void WebAudioContainer::addComponent (GraphEmbeddedComponent* compToAdd)
 {
     components.addIfNotAlreadyThere (compToAdd);
+    parentPanel.containerContentChanged (this, compToAdd, true);
 }
 
 void WebAudioContainer::removeComponent (GraphEmbeddedComponent* compToRemove)
 {
     components.removeObject (compToRemove);
+    parentPanel.containerContentChanged (this, compToRemove, false);
 }
 
 void WebAudioContainer::checkContent()
 {
     if (auto graph = getParentGraph())
+    {
         for (int i = components.size(); --i >= 0;)
+        {
             if (! graph->getEmbeddedComponents().contains (components.getUnchecked(i)))
+            {
+                parentPanel.containerContentChanged (this, components.getUnchecked(i), false);
                 components.remove (i);
+            }
+        }
+    }
     
     navigableChanged();
 }
@@ -1300,7 +1368,7 @@ void WebAudioContainer::mouseUp (const MouseEvent &e)
         showNameEditor();
     
     if (e.mouseWasDraggedSinceMouseDown())
-        getWebAudioGraph().containerMoved();
+        getWebAudioGraph().containerMoved (this);
 }
 
 void WebAudioContainer::mouseDrag (const MouseEvent &e)
@@ -1386,7 +1454,7 @@ void WebAudioContainer::wasDragged (const MouseEvent &e, bool dragIsOver, bool i
     WebAudioEmbedded::wasDragged (e, dragIsOver, isUniqueSelection);
     
     if (dragIsOver)
-        getWebAudioGraph().containerMoved();
+        getWebAudioGraph().containerMoved (this);
 }
 
 void WebAudioContainer::inspectablePropertyChanged (ValueTree &tree, const Identifier &property)
@@ -1398,7 +1466,7 @@ void WebAudioContainer::inspectablePropertyChanged (ValueTree &tree, const Ident
         const auto propName = tree["name"];
         
         if (propName == "width" || propName == "height" || propName == "x" || propName == "y")
-            getWebAudioGraph().containerMoved();
+            getWebAudioGraph().containerMoved (this);
     }
     
 }
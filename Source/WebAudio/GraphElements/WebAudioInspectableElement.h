@@ -30,6 +30,10 @@ public:
     void setSizeProperties();
     
     WebAudioNodeInstance* getInstance() const;
+    
+    // Called by the instance, which may be shared with other elements, when its options changed
+    void instanceOptionsChanged();
+    
     ValueTree getPropertyValueTree();
     
     ValueTree createEditableProperty (String name, String type, String defaultValue, String attributes = String());
@@ -63,6 +67,9 @@ protected:
     virtual void prepareInspectablePropertiesTree (String typeName);
     virtual ValueTree createNameProperty();
     String getTypeDisplayString (String type) const;
+    
+    // Lets the panel know that the code generated for this element may change
+    void contentChanged();
 
     WebAudioGraphPanel& parentPanel;
     const Descriptor privateDescriptor;
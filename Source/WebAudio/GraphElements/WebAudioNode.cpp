@@ -75,9 +75,11 @@ void WebAudioNode::checkContainers (bool useHighlight)
         shouldBeInContext = getAudioContextName();
     else
     {
-        for (auto n : parentPanel.getAllNodesInContexts())
+        for (auto emb : parentPanel.getAllElementsWithName (getPublicName()))
         {
-            if (n != this && n->getPublicName() == getPublicName())
+            auto n = dynamic_cast<WebAudioNode*> (emb);
+            
+            if (n != nullptr && n != this && n->getAudioContext() != nullptr)
             {
                 shouldBeInContext = n->getAudioContextName();
                 break;
@@ -88,9 +90,9 @@ void WebAudioNode::checkContainers (bool useHighlight)
     const auto centre = getBounds().removeFromTop (getDefaultHeight()).getCentre();
     bool targetContextFound = false;
     
-    for (auto cont : parentPanel.getContainers())
+    for (auto cont : parentPanel.getContainersToCheck (this, centre))
     {
-        if (auto ctx = dynamic_cast<WebAudioContext*> (cont.get()))
+        if (auto ctx = dynamic_cast<WebAudioContext*> (cont))
         {
             bool wrongContext = false;
             
@@ -116,7 +118,7 @@ void WebAudioNode::checkContainers (bool useHighlight)
                 ctx->setHighlighted (false);
             }
         }
-        else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont.get()))
+        else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont))
         {
             if (dr->getBounds().contains (centre))
             {
@@ -318,12 +320,11 @@ bool WebAudioNode::nameIsAlreadyTaken (String name)
     if (WebAudioEmbedded::nameIsAlreadyTaken (name))
         return true;
     
-    for (auto emb : getParentGraph()->getEmbeddedComponents())
+    for (auto emb : parentPanel.getAllElementsWithName (name))
     {
         if (auto node = dynamic_cast<WebAudioNode*>(emb))
         {
-            if (node != this && node->getPublicName() == name &&
-                node->getAudioContextName() != getAudioContextName())
+            if (node != this && node->getAudioContextName() != getAudioContextName())
                 return true;
         }
     }
@@ -360,9 +361,9 @@ void WebAudioDestinationNode::checkContainers (bool useHighlight)
     
     WebAudioContext* newCtx = nullptr;
     
-    for (auto cont : parentPanel.getContainers())
+    for (auto cont : parentPanel.getContainersToCheck (this, centre))
     {
-        if (auto ctx = dynamic_cast<WebAudioContext*> (cont.get()))
+        if (auto ctx = dynamic_cast<WebAudioContext*> (cont))
         {
             const bool wrongContext = (shouldBeInContext != String() && shouldBeInContext != ctx->getPublicName());
             
@@ -383,7 +384,7 @@ void WebAudioDestinationNode::checkContainers (bool useHighlight)
                 ctx->removeComponent (this);
             }
         }
-        else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont.get()))
+        else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont))
         {
             if (dr->getBounds().contains (centre))
             {
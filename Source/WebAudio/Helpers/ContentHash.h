@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// 64-bit FNV-1a hash, used to tell whether generated or copied files changed
+struct ContentHash
+{
+    void update (const void* data, size_t numBytes)
+    {
+        auto bytes = static_cast<const uint8*> (data);
+        
+        for (size_t i = 0; i < numBytes; ++i)
+            value = (value ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    
+    // Reads the stream by blocks until its end
+    void update (InputStream& stream)
+    {
+        HeapBlock<char> buffer (blockSize);
+        
+        for (;;)
+        {
+            const int numRead = stream.read (buffer, blockSize);
+            
+            if (numRead <= 0)
+                break;
+            
+            update (buffer, (size_t) numRead);
+        }
+    }
+    
+    String toHexString() const
+    {
+        return String::toHexString ((int64) value).paddedLeft ('0', 16);
+    }
+    
+    enum { blockSize = 65536 };
+    
+    uint64 value = 0xcbf29ce484222325ULL;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+struct HashMapHelpers
+{
+    // Looks a key up without copying its value, nor adding a default one when the key is missing.
+    // A missing key gives a default-constructed value shared by all the callers.
+    template <typename KeyType, typename ValueType, class HashFunctionType, class CriticalSectionType>
+    static const ValueType& find (const HashMap<KeyType, ValueType, HashFunctionType, CriticalSectionType>& map,
+                                  typename TypeHelpers::ParameterType<KeyType>::type key)
+    {
+        static const ValueType empty {};
+        
+        if (! map.contains (key))
+            return empty;
+        
+        // getReference() only inserts missing keys, which were ruled out above
+        using MapType = HashMap<KeyType, ValueType, HashFunctionType, CriticalSectionType>;
+        return const_cast<MapType&> (map).getReference (key);
+    }
+};
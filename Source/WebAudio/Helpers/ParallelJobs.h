@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Runs independent jobs on a ThreadPool and waits for all of them
+struct ParallelJobs
+{
+    static int getDefaultNumThreads()
+    {
+        return jlimit (1, 8, SystemStats::getNumCpus());
+    }
+    
+    // Calls job (0) to job (numJobs - 1) on the pool's threads and returns once they're all finished.
+    // The caller joins the results, usually by storing them at the job's index.
+    static void run (ThreadPool& pool, int numJobs, std::function<void (int)> job)
+    {
+        if (numJobs == 1)
+        {
+            job (0);
+            return;
+        }
+        
+        struct IndexedJob  : public ThreadPoolJob
+        {
+            IndexedJob (std::function<void (int)>& f, int i) : ThreadPoolJob ("Parallel job"), function (f), index (i) {}
+            
+            JobStatus runJob() override
+            {
+                function (index);
+                return jobHasFinished;
+            }
+            
+            std::function<void (int)>& function;
+            const int index;
+        };
+        
+        OwnedArray<IndexedJob> jobs;
+        
+        for (int i = 0; i < numJobs; ++i)
+            pool.addJob (jobs.add (new IndexedJob (job, i)), false);
+        
+        for (auto j : jobs)
+            pool.waitForJobToFinish (j, -1);
+    }
+};
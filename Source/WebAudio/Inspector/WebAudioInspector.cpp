@@ -162,7 +162,7 @@ void WebAudioInspector::valueTreePropertyChanged (ValueTree &tree, const Identif
             um = &graphPanel->getUndoManager();
         
         if (um != nullptr)
-            um->beginNewTransaction();
+            getPropertyTree()->beginEditTransaction (*um, tree);
         
         for (auto t : cp->linkedTrees)
         {
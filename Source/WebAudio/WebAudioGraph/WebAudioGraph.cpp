@@ -9,6 +9,9 @@
 */
 
 #include "WebAudioGraph.h"
+#include "WebAudioGraphModel.h"
+#include "WebAudioOutputWriter.h"
+#include "HashMapHelpers.h"
 
 //==============================================================================
 
@@ -40,6 +43,13 @@ void WebAudioGraph::focusGained (FocusChangeType cause)
 #include "WebAudioScript.h"
 #include "WebAudioComment.h"
 
+// Memory footprint of an element kept alive by the undo history, measured from its saved state
+static int getStateSizeInUnits (WebAudioGraph& graph, GraphEmbeddedComponent* comp)
+{
+    ScopedPointer<XmlElement> xml (graph.getXmlFor (comp));
+    return xml != nullptr ? (int) xml->createDocument (String(), true, false).getNumBytesAsUTF8() : 0;
+}
+
 class UndoableRemove : public UndoableAction
 {
 public:
@@ -58,6 +68,10 @@ public:
         if (auto node = dynamic_cast<WebAudioNode*> (persistantRef.get()))
             persistantCtx = node->getAudioContext();
         
+        // Measured once, the undo manager expects a constant size
+        if (stateSize == 0)
+            stateSize = getStateSizeInUnits (graph, persistantRef.get());
+        
         if (graph.removeComponent (persistantRef.get(), false))
         {
             panel.navigableChanged();
@@ -84,12 +98,15 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this) + stateSize; }
+    
 private:
     WebAudioGraphPanel &panel;
     WebAudioGraph &graph;
     WebAudioEmbedded::Ptr persistantRef;
     WebAudioEmbedded::Ptr persistantCtx;
     Point<int> pos;
+    int stateSize = 0;
 };
 
 bool WebAudioGraph::removeComponent (GraphEmbeddedComponent* comp, bool undoable)
@@ -120,6 +137,29 @@ bool WebAudioGraph::removeComponent (GraphEmbeddedComponent* comp, bool undoable
     }
 }
 
+void WebAudioGraph::embeddedComponentAdded (GraphEmbeddedComponent* comp)
+{
+    owner.registerElement (comp);
+}
+
+void WebAudioGraph::embeddedComponentRemoved (GraphEmbeddedComponent* comp)
+{
+    owner.unregisterElement (comp);
+}
+
+void WebAudioGraph::graphCleared()
+{
+    owner.clearRegistries();
+}
+
+void WebAudioGraph::graphIdChanged (GraphEmbeddedComponent* comp, int previousId)
+{
+    GraphPanel::graphIdChanged (comp, previousId);
+    
+    owner.elementChanged (previousId);
+    owner.elementChanged (comp->getGraphId());
+}
+
 class UndoableConnect : public UndoableAction
 {
 public:
@@ -152,6 +192,8 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this); }
+    
 private:
     WebAudioGraph &graph;
     const WeakReference<Pin> source;
@@ -203,6 +245,8 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this); }
+    
 private:
     WebAudioGraph &graph;
     const WeakReference<Pin> source;
@@ -466,25 +510,26 @@ void WebAudioGraph::showPopupMenu (Point<int> position)
     return owner.showPopupMenu (position);
 }
 
-void WebAudioGraph::containerMoved()
+void WebAudioGraph::containerMoved (WebAudioContainer* cont)
 {
-    for (auto& node : owner.getAllNodes())
-        node->checkContainers (false);
-    
-    for (auto& dr : owner.getAllDynamicRoutes())
-        dr->checkContainers (false);
-    
-    for (auto& msg : owner.getAllMessages())
-        msg->checkContainers (false);
+    if (cont == nullptr)
+        return;
     
-    for (auto& f : owner.getAllScripts())
-        f->checkContainers (false);
+    // Only the elements lying over the container or currently inside it can be affected
+    Array<GraphEmbeddedComponent*> elementsToCheck (getSpatialIndex().findComponentsIntersecting (cont->getBounds()));
     
-    for (auto& b : owner.getAllAudioData())
-        b->checkContainers (false);
+    for (auto emb : cont->getContent())
+        elementsToCheck.addIfNotAlreadyThere (emb);
     
-    for (auto c : owner.getAllComments())
-        c->checkContainers (false);
+    for (auto emb : elementsToCheck)
+    {
+        // Contexts are never contained
+        if (emb == cont || dynamic_cast<WebAudioContext*> (emb) != nullptr)
+            continue;
+        
+        if (auto webEmb = dynamic_cast<WebAudioEmbedded*> (emb))
+            webEmb->checkContainers (false);
+    }
     
     repaint();
 }
@@ -495,6 +540,8 @@ void WebAudioGraph::loadStateFromXml (const XmlElement& e)
     owner.graphSelectionChanged();
 }
 
+// Only the first perform() parses the document. The action then keeps the pasted elements
+// and their connections, which redo adds back.
 class UndoablePaste : public UndoableAction
 {
 public:
@@ -502,10 +549,16 @@ public:
     
     bool perform() override
     {
-        if (comps.isEmpty())
+        const GraphPanel::BulkUpdate bulkUpdate (graph);
+        
+        if (xmlDoc.isNotEmpty())
         {
             auto pasted = graph.pasteAndReturn (xmlDoc, connectionInfo);
             
+            // The pasted elements now hold the document's state
+            stateSize = (int) xmlDoc.getNumBytesAsUTF8();
+            xmlDoc.clear();
+            
             for (auto comp : pasted)
             {
                 comp->setTopLeftPosition (comp->getX() + offset.getX(), comp->getY() + offset.getY());
@@ -536,16 +589,27 @@ public:
     
     bool undo() override
     {
+        const GraphPanel::BulkUpdate bulkUpdate (graph);
+        
         for (auto pasted : comps)
             graph.removeComponent (pasted->comp, false);
         
         return true;
     }
     
+    int getSizeInUnits() override
+    {
+        return (int) sizeof (*this)
+            + stateSize
+            + comps.size() * (int) sizeof (PastedComp)
+            + connectionInfo.size() * (int) sizeof (ConnectionInfo);
+    }
+    
 private:
     WebAudioGraph &graph;
-    const String xmlDoc;
+    String xmlDoc;
     Point<int> offset;
+    int stateSize = 0;
     
     struct PastedComp
     {
@@ -553,7 +617,6 @@ private:
         
         WebAudioEmbedded::Ptr comp;
         const Point<int> pos;
-        Array<ConnectionInfo> connections;
     };
     
     OwnedArray<PastedComp> comps;
@@ -914,6 +977,9 @@ void WebAudioGraphPanel::getCommandInfo (CommandID commandID, ApplicationCommand
 
 bool WebAudioGraphPanel::perform (const InvocationInfo& info)
 {
+    // A single transaction can hold many actions, e.g. when deleting a large selection
+    const GraphPanel::BulkUpdate bulkUpdate (graphPanel);
+    
     if (info.commandID == CommandIDs::undo)
         return graphPanel.getUndoManager().undo();
     else if (info.commandID == CommandIDs::redo)
@@ -1016,6 +1082,10 @@ public:
         {
             persistantRef->setCentrePosition (pos);
             persistantRef->setPositionOnLastMouseDown();
+            
+            // Measured once, the undo manager expects a constant size
+            if (stateSize == 0)
+                stateSize = getStateSizeInUnits (graph, persistantRef.get());
         }
         
         panel.navigableChanged();
@@ -1035,10 +1105,13 @@ public:
         return true;
     }
     
+    int getSizeInUnits() override { return (int) sizeof (*this) + stateSize; }
+    
     GraphEmbeddedComponent* getComponent() { return persistantRef; }
     
 private:
     WebAudioEmbedded::Ptr persistantRef;
+    int stateSize = 0;
     
     WebAudioGraphPanel &panel;
     WebAudioGraph &graph;
@@ -1214,11 +1287,7 @@ WebAudioComment* WebAudioGraphPanel::addComment (int xPos, int yPos)
 
 Array<WebAudioContext*> WebAudioGraphPanel::getAllContexts (bool sorted) const
 {
-    Array<WebAudioContext*> result;
-    
-    for (auto cont : getContainers())
-        if (auto ctx = dynamic_cast<WebAudioContext*> (cont.get()))
-            result.add (ctx);
+    Array<WebAudioContext*> result (contexts);
     
     if (sorted)
     {
@@ -1231,20 +1300,14 @@ Array<WebAudioContext*> WebAudioGraphPanel::getAllContexts (bool sorted) const
 
 Array<WebAudioNode*> WebAudioGraphPanel::getAllNodes() const
 {
-    Array<WebAudioNode*> result;
-    
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto n = dynamic_cast<WebAudioNode*> (emb))
-            result.add (n);
-    
-    return result;
+    return nodes;
 }
 
 Array<WebAudioNode*> WebAudioGraphPanel::getAllNodesInContexts() const
 {
     Array<WebAudioNode*> result;
     
-    for (auto c : getAllContexts())
+    for (auto c : contexts)
         result.addArray (c->getAllNodes());
     
     return result;
@@ -1254,10 +1317,9 @@ Array<WebAudioNode*> WebAudioGraphPanel::getAllNodesWithoutContext (bool sorted)
 {
     Array<WebAudioNode*> result;
     
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto n = dynamic_cast<WebAudioNode*> (emb))
-            if (n->getAudioContext() == nullptr)
-                result.add (n);
+    for (auto n : nodes)
+        if (n->getAudioContext() == nullptr)
+            result.add (n);
     
     if (sorted)
     {
@@ -1270,11 +1332,7 @@ Array<WebAudioNode*> WebAudioGraphPanel::getAllNodesWithoutContext (bool sorted)
 
 Array<WebAudioDynamicRoute*> WebAudioGraphPanel::getAllDynamicRoutes (bool sorted) const
 {
-    Array<WebAudioDynamicRoute*> result;
-    
-    for (auto cont : getContainers())
-        if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont.get()))
-            result.add (dr);
+    Array<WebAudioDynamicRoute*> result (dynamicRoutes);
     
     if (sorted)
     {
@@ -1287,46 +1345,28 @@ Array<WebAudioDynamicRoute*> WebAudioGraphPanel::getAllDynamicRoutes (bool sorte
 
 Array<WebAudioDynamicRoute*> WebAudioGraphPanel::getAllDynamicRoutesContaining (GraphEmbeddedComponent* comp) const
 {
-    Array<WebAudioDynamicRoute*> result;
-    
-    for (auto cont : getContainers())
-        if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont.get()))
-            if (dr->getContent().contains (comp))
-                result.add (dr);
-    
-    return result;
+    return dynamicRoutesByContent[comp];
 }
 
 Array<WebAudioMessage*> WebAudioGraphPanel::getAllMessages() const
 {
-    Array<WebAudioMessage*> result;
-    
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto m = dynamic_cast<WebAudioMessage*> (emb))
-            result.add (m);
-    
-    return result;
+    return messages;
 }
 
 Array<WebAudioMessage*> WebAudioGraphPanel::getAllMessagesAtRoot() const
 {
     Array<WebAudioMessage*> result;
     
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto m = dynamic_cast<WebAudioMessage*> (emb))
-            if (getAllDynamicRoutesContaining (m).isEmpty())
-                result.add (m);
+    for (auto m : messages)
+        if (! dynamicRoutesByContent.contains (m))
+            result.add (m);
     
     return result;
 }
 
 Array<WebAudioData*> WebAudioGraphPanel::getAllAudioData (bool sorted) const
 {
-    Array<WebAudioData*> result;
-    
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto b = dynamic_cast<WebAudioData*> (emb))
-            result.add (b);
+    Array<WebAudioData*> result (audioData);
     
     if (sorted)
     {
@@ -1339,23 +1379,16 @@ Array<WebAudioData*> WebAudioGraphPanel::getAllAudioData (bool sorted) const
 
 Array<WebAudioScript*> WebAudioGraphPanel::getAllScripts() const
 {
-    Array<WebAudioScript*> result;
-    
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto f = dynamic_cast<WebAudioScript*> (emb))
-            result.add (f);
-    
-    return result;
+    return scripts;
 }
 
 Array<WebAudioScript*> WebAudioGraphPanel::getAllScriptsAtRoot() const
 {
     Array<WebAudioScript*> result;
     
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto f = dynamic_cast<WebAudioScript*> (emb))
-            if (getAllDynamicRoutesContaining (f).isEmpty())
-                result.add (f);
+    for (auto f : scripts)
+        if (! dynamicRoutesByContent.contains (f))
+            result.add (f);
     
     return result;
 }
@@ -1380,13 +1413,67 @@ Array<WebAudioEmbedded*> WebAudioGraphPanel::getAllScriptsAndMessagesAtRoot (boo
 
 Array<WebAudioComment*> WebAudioGraphPanel::getAllComments() const
 {
-    Array<WebAudioComment*> result;
+    return comments;
+}
+
+void WebAudioGraphPanel::createModelSnapshot (WebAudioGraphModel& model)
+{
+    model.clear();
+    model.setPageTitle (project.isTemporary() ? String() : project.getName());
     
-    for (auto emb : graphPanel.getEmbeddedComponents())
-        if (auto c = dynamic_cast<WebAudioComment*> (emb))
-            result.add (c);
+    for (auto comp : graphPanel.getEmbeddedComponents())
+    {
+        auto emb = dynamic_cast<WebAudioEmbedded*> (comp);
+        
+        if (emb == nullptr)
+            continue;
+        
+        WebAudioGraphModel::Element element;
+        element.graphId = emb->getGraphId();
+        element.type = emb->getUICompTypeName();
+        element.name = emb->getPublicName();
+        element.interfaceName = emb->getInterfaceName();
+        element.bounds = emb->getBounds();
+        element.colour = emb->getBackgroundColour();
+        
+        if (auto instance = emb->getInstance())
+        {
+            element.hasInstance = true;
+            
+            for (auto o : instance->getOptions())
+                element.options.add ({ o->name, o->defaultValue });
+        }
+        
+        if (auto n = dynamic_cast<WebAudioNode*> (emb))
+        {
+            if (auto ctx = n->getAudioContext())
+                element.contextId = ctx->getGraphId();
+        }
+        else if (auto s = dynamic_cast<WebAudioScript*> (emb))
+        {
+            element.scriptContent = s->getEditorContent();
+        }
+        else if (auto d = dynamic_cast<WebAudioData*> (emb))
+        {
+            if (auto file = d->getLinkedAudioFile())
+                element.linkedFileUuid = file->getUuid().toString();
+        }
+        
+        for (auto dr : getAllDynamicRoutesContaining (emb))
+            element.dynamicRouteIds.add (dr->getGraphId());
+        
+        model.addElement (element);
+    }
     
-    return result;
+    for (auto c : graphPanel.getConnections())
+    {
+        const auto info = c->getInfo();
+        
+        model.addConnection ({ info.sourceComp->getGraphId(), info.sourceIndex,
+                               static_cast<WebAudioGraphModel::PinPlacement> (info.sourcePlacement),
+                               info.destComp->getGraphId(), info.destIndex,
+                               static_cast<WebAudioGraphModel::PinPlacement> (info.destPlacement) });
+    }
 }
 
 XmlElement* WebAudioGraphPanel::getAsXml()
@@ -1406,10 +1493,15 @@ void WebAudioGraphPanel::restoreState (XmlElement* state)
     
     setPanelId (state->getIntAttribute ("panelId"));
     
-    if (auto graphXml = state->getChildByName ("GraphPanel"))
-        graphPanel.loadStateFromXml (*graphXml);
+    {
+        const GraphPanel::BulkUpdate bulkUpdate (graphPanel);
+        
+        if (auto graphXml = state->getChildByName ("GraphPanel"))
+            graphPanel.loadStateFromXml (*graphXml);
+        
+        graphPanel.sortWithZ (true);
+    }
     
-    graphPanel.sortWithZ (true);
     navigableChanged();
     
     graphPanel.getUndoManager().clearUndoHistory ();
@@ -1466,11 +1558,7 @@ void WebAudioGraphPanel::saveSelectionAsPreset()
 
 String WebAudioGraphPanel::getUnusedName (String desiredName) const
 {
-    int categoryFlags = contextCategory | nodeCategory | dataCategory | dynamicRouteCategory | functionCategory;
-    
-    WebAudioEmbedded* comp = findElementWithName (desiredName, categoryFlags);
-    
-    if (comp == nullptr)
+    if (findElementWithName (desiredName, uniqueNameCategories) == nullptr)
         return desiredName;
     
     // Remove suffix
@@ -1487,24 +1575,25 @@ String WebAudioGraphPanel::getUnusedName (String desiredName) const
         startIndex = suffixStart + 1;
     }
     
-    int number = 1;
-    
-    String newName;
+    // Lowest free suffix from 2
+    int number = HashMapHelpers::find (usedSuffixesForBaseName, desiredName).getLowestFree();
     
-    do
+    for (;;)
     {
-        newName = desiredName;
+        String newName (desiredName);
         
         if (CharacterFunctions::isDigit (desiredName.getLastCharacter()))
             newName << '_'; // pad with an underscore if the name already ends in a digit
         
-        newName << ++number;
+        newName << number;
         
-        comp = findElementWithName (newName, categoryFlags);
+        // The index should have it right, but a duplicate name would break the generated code
+        if (findElementWithName (newName, uniqueNameCategories) == nullptr)
+            return newName;
         
-    } while (comp != nullptr);
-    
-    return newName;
+        jassertfalse;
+        ++number;
+    }
 }
 
 Point<int> WebAudioGraphPanel::getCenterOfVisibleGraphArea() const
@@ -1564,122 +1653,492 @@ void WebAudioGraphPanel::itemDragExit (const SourceDetails &dragSourceDetails)
 
 void WebAudioGraphPanel::addContainer (WebAudioContainer* cont)
 {
-    containers.addIfNotAlreadyThere (cont);
+    if (! containerOrder.contains (cont))
+    {
+        containers.add (cont);
+        containerOrder.set (cont, nextContainerOrder++);
+    }
+    
+    if (auto ctx = dynamic_cast<WebAudioContext*> (cont))
+        contexts.addIfNotAlreadyThere (ctx);
+    else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont))
+        dynamicRoutes.addIfNotAlreadyThere (dr);
+    
+    for (auto comp : cont->getContent())
+        containerContentChanged (cont, comp, true);
 }
 
 void WebAudioGraphPanel::removeContainer (WebAudioContainer* cont)
 {
+    for (auto comp : cont->getContent())
+        containerContentChanged (cont, comp, false);
+    
     containers.removeFirstMatchingValue (cont);
+    containerOrder.remove (cont);
+    
+    if (auto ctx = dynamic_cast<WebAudioContext*> (cont))
+        contexts.removeFirstMatchingValue (ctx);
+    else if (auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont))
+        dynamicRoutes.removeFirstMatchingValue (dr);
 }
 
-WebAudioEmbedded* WebAudioGraphPanel::findElementWithName (String name, int category) const
+void WebAudioGraphPanel::containerContentChanged (WebAudioContainer* cont, GraphEmbeddedComponent* comp, bool wasAdded)
 {
-    if (category & contextCategory)
+    if (cont == nullptr || comp == nullptr)
+        return;
+    
+    auto dr = dynamic_cast<WebAudioDynamicRoute*> (cont);
+    
+    if (wasAdded)
     {
-        for (auto c : getAllContexts())
-            if (c->getPublicName() == name)
-                return c;
+        // Only containers that are currently in the graph are indexed
+        if (! containerOrder.contains (cont))
+            return;
+        
+        containersByContent.getReference (comp).addIfNotAlreadyThere (cont);
+        
+        if (dr != nullptr)
+            dynamicRoutesByContent.getReference (comp).addIfNotAlreadyThere (dr);
+        
+        return;
     }
     
-    if (category & dataCategory)
+    if (containersByContent.contains (comp))
     {
-        for (auto d : getAllAudioData())
-            if (d->getPublicName() == name)
-                return d;
+        auto& parents = containersByContent.getReference (comp);
+        parents.removeFirstMatchingValue (cont);
+        
+        if (parents.isEmpty())
+            containersByContent.remove (comp);
     }
     
-    if (category & nodeCategory)
+    if (dr != nullptr && dynamicRoutesByContent.contains (comp))
     {
-        for (auto n : getAllNodes())
-            if (n->getPublicName() == name)
-                return n;
+        auto& routes = dynamicRoutesByContent.getReference (comp);
+        routes.removeFirstMatchingValue (dr);
+        
+        if (routes.isEmpty())
+            dynamicRoutesByContent.remove (comp);
     }
+}
+
+Array<WebAudioContainer*> WebAudioGraphPanel::getContainersToCheck (const GraphEmbeddedComponent* comp, Point<int> point) const
+{
+    Array<WebAudioContainer*> candidates (HashMapHelpers::find (containersByContent, comp));
+    
+    for (auto emb : graphPanel.getSpatialIndex().findComponentsAt (point))
+        if (auto cont = dynamic_cast<WebAudioContainer*> (emb))
+            if (cont != comp && containerOrder.contains (cont))
+                candidates.addIfNotAlreadyThere (cont);
     
-    if (category & messageCategory)
+    // Keeps the order of the containers array, which matters when looking for a context
+    struct ContainerOrderComparator
     {
-        for (auto m : getAllMessages())
-            if (m->getPublicName() == name)
-                return m;
-    }
+        ContainerOrderComparator (const HashMap<const WebAudioContainer*, int>& o) : order (o) {}
+        
+        int compareElements (WebAudioContainer* first, WebAudioContainer* second) const
+        {
+            return order[first] - order[second];
+        }
+        
+        const HashMap<const WebAudioContainer*, int>& order;
+    };
+    
+    ContainerOrderComparator comparator (containerOrder);
+    candidates.sort (comparator);
+    
+    return candidates;
+}
+
+void WebAudioGraphPanel::registerElement (GraphEmbeddedComponent* comp)
+{
+    elementChanged (comp->getGraphId());
     
-    if (category & dynamicRouteCategory)
+    if (auto emb = dynamic_cast<WebAudioEmbedded*> (comp))
     {
-        for (auto dr : getAllDynamicRoutes())
-            if (dr->getPublicName() == name)
-                return dr;
+        auto& elements = elementsByName.getReference (emb->getPublicName());
+        
+        if (! elements.contains (emb))
+        {
+            elements.add (emb);
+            indexNameSuffix (emb, emb->getPublicName());
+        }
     }
     
-    if (category & functionCategory)
+    if (auto n = dynamic_cast<WebAudioNode*> (comp))
+        nodes.addIfNotAlreadyThere (n);
+    else if (auto m = dynamic_cast<WebAudioMessage*> (comp))
+        messages.addIfNotAlreadyThere (m);
+    else if (auto d = dynamic_cast<WebAudioData*> (comp))
+        audioData.addIfNotAlreadyThere (d);
+    else if (auto f = dynamic_cast<WebAudioScript*> (comp))
+        scripts.addIfNotAlreadyThere (f);
+    else if (auto c = dynamic_cast<WebAudioComment*> (comp))
+        comments.addIfNotAlreadyThere (c);
+}
+
+void WebAudioGraphPanel::unregisterElement (GraphEmbeddedComponent* comp)
+{
+    elementChanged (comp->getGraphId());
+    
+    if (auto emb = dynamic_cast<WebAudioEmbedded*> (comp))
     {
-        for (auto f : getAllScripts())
-            if (f->getPublicName() == name)
-                return f;
+        const String name (emb->getPublicName());
+        
+        if (elementsByName.contains (name))
+        {
+            auto& elements = elementsByName.getReference (name);
+            
+            if (elements.contains (emb))
+            {
+                elements.removeFirstMatchingValue (emb);
+                unindexNameSuffix (emb, name);
+            }
+            
+            if (elements.isEmpty())
+                elementsByName.remove (name);
+        }
     }
     
-    return nullptr;
+    if (auto n = dynamic_cast<WebAudioNode*> (comp))
+        nodes.removeFirstMatchingValue (n);
+    else if (auto m = dynamic_cast<WebAudioMessage*> (comp))
+        messages.removeFirstMatchingValue (m);
+    else if (auto d = dynamic_cast<WebAudioData*> (comp))
+        audioData.removeFirstMatchingValue (d);
+    else if (auto f = dynamic_cast<WebAudioScript*> (comp))
+        scripts.removeFirstMatchingValue (f);
+    else if (auto c = dynamic_cast<WebAudioComment*> (comp))
+        comments.removeFirstMatchingValue (c);
+}
+
+void WebAudioGraphPanel::clearRegistries()
+{
+    containers.clear();
+    containerOrder.clear();
+    contexts.clear();
+    nodes.clear();
+    dynamicRoutes.clear();
+    messages.clear();
+    audioData.clear();
+    scripts.clear();
+    comments.clear();
+    containersByContent.clear();
+    dynamicRoutesByContent.clear();
+    elementsByName.clear();
+    usedSuffixesForBaseName.clear();
+}
+
+void WebAudioGraphPanel::elementNameChanged (WebAudioEmbedded* element, const String& oldName)
+{
+    if (! elementsByName.contains (oldName))
+        return;
+    
+    auto& elements = elementsByName.getReference (oldName);
+    
+    // Elements not currently in the graph aren't indexed
+    if (! elements.contains (element))
+        return;
+    
+    elements.removeFirstMatchingValue (element);
+    
+    unindexNameSuffix (element, oldName);
+    
+    if (elements.isEmpty())
+        elementsByName.remove (oldName);
+    
+    elementsByName.getReference (element->getPublicName()).add (element);
+    indexNameSuffix (element, element->getPublicName());
+}
+
+// getUnusedName() appends a number from 2 to the base name, after an underscore if the base
+// name ends with a digit. "name_2" may have been given for "name_" as well as for "name".
+static StringArray getBaseNamesForSuffixedName (const String& name, int& suffix)
+{
+    StringArray baseNames;
+    int digitsStart = name.length();
+    
+    while (digitsStart > 0 && CharacterFunctions::isDigit (name[digitsStart - 1]))
+        --digitsStart;
+    
+    const String digits (name.substring (digitsStart));
+    
+    if (digits.isEmpty() || digits.length() > 9 || digits[0] == '0')
+        return baseNames;
+    
+    suffix = digits.getIntValue();
+    
+    if (suffix < 2)
+        return baseNames;
+    
+    const String prefix (name.substring (0, digitsStart));
+    baseNames.add (prefix);
+    
+    if (prefix.endsWithChar ('_') && CharacterFunctions::isDigit (prefix.dropLastCharacters (1).getLastCharacter()))
+        baseNames.add (prefix.dropLastCharacters (1));
+    
+    return baseNames;
+}
+
+// A base name and a suffix always make the same name, so a suffix stays used until the last
+// element with that name is gone
+bool WebAudioGraphPanel::isNameSuffixShared (const WebAudioEmbedded* element, const String& name) const
+{
+    for (auto emb : HashMapHelpers::find (elementsByName, name))
+        if (emb != element && (getElementCategory (emb) & uniqueNameCategories) != 0)
+            return true;
+    
+    return false;
+}
+
+void WebAudioGraphPanel::indexNameSuffix (const WebAudioEmbedded* element, const String& name)
+{
+    if ((getElementCategory (element) & uniqueNameCategories) == 0 || isNameSuffixShared (element, name))
+        return;
+    
+    int suffix = 0;
+    
+    for (auto& baseName : getBaseNamesForSuffixedName (name, suffix))
+        usedSuffixesForBaseName.getReference (baseName).use (suffix);
+}
+
+void WebAudioGraphPanel::unindexNameSuffix (const WebAudioEmbedded* element, const String& name)
+{
+    if ((getElementCategory (element) & uniqueNameCategories) == 0 || isNameSuffixShared (element, name))
+        return;
+    
+    int suffix = 0;
+    
+    for (auto& baseName : getBaseNamesForSuffixedName (name, suffix))
+    {
+        if (! usedSuffixesForBaseName.contains (baseName))
+            continue;
+        
+        auto& suffixes = usedSuffixesForBaseName.getReference (baseName);
+        suffixes.release (suffix);
+        
+        if (suffixes.isEmpty())
+            usedSuffixesForBaseName.remove (baseName);
+    }
 }
 
 //==============================================================================
+void WebAudioGraphPanel::NameSuffixes::use (int suffix)
+{
+    if (suffix < nextFree)
+    {
+        freed.removeValue (suffix);
+    }
+    else if (suffix > nextFree)
+    {
+        usedAboveNextFree.add (suffix);
+    }
+    else
+    {
+        ++nextFree;
+        
+        while (usedAboveNextFree.size() > 0 && usedAboveNextFree.getFirst() == nextFree)
+        {
+            usedAboveNextFree.remove (0);
+            ++nextFree;
+        }
+    }
+}
 
-RootWebAudioGraphPanel::RootWebAudioGraphPanel (Project& proj) : WebAudioGraphPanel (proj), project (proj), generator (*this)
+void WebAudioGraphPanel::NameSuffixes::release (int suffix)
 {
-    setPanelName ("Audio graph");
+    if (suffix >= nextFree)
+    {
+        usedAboveNextFree.removeValue (suffix);
+        return;
+    }
+    
+    freed.add (suffix);
+    
+    // Keeps the freed suffixes below the highest used one
+    while (freed.size() > 0 && freed.getLast() == nextFree - 1)
+    {
+        freed.remove (freed.size() - 1);
+        --nextFree;
+    }
 }
 
-void RootWebAudioGraphPanel::generateOutput (bool openInEditor)
+int WebAudioGraphPanel::getElementCategory (const WebAudioEmbedded* element)
 {
-    auto projectDirectory = project.getProjectDirectory();
+    if (dynamic_cast<const WebAudioContext*> (element) != nullptr)          return contextCategory;
+    if (dynamic_cast<const WebAudioData*> (element) != nullptr)             return dataCategory;
+    if (dynamic_cast<const WebAudioNode*> (element) != nullptr)             return nodeCategory;
+    if (dynamic_cast<const WebAudioMessage*> (element) != nullptr)          return messageCategory;
+    if (dynamic_cast<const WebAudioDynamicRoute*> (element) != nullptr)     return dynamicRouteCategory;
+    if (dynamic_cast<const WebAudioScript*> (element) != nullptr)           return functionCategory;
+    if (dynamic_cast<const WebAudioComment*> (element) != nullptr)          return commentCategory;
     
-    // Create directories
-    auto outputDir = projectDirectory.getChildFile ("output");
-    auto jsDir = outputDir.getChildFile ("js");
-    auto dataDir = outputDir.getChildFile ("data");
+    return 0;
+}
+
+WebAudioEmbedded* WebAudioGraphPanel::findElementWithName (String name, int category) const
+{
+    if (! elementsByName.contains (name))
+        return nullptr;
     
-    if (! outputDir.exists())   outputDir.createDirectory();
-    if (! jsDir.exists())       jsDir.createDirectory();
-    if (! dataDir.exists())     dataDir.createDirectory();
+    // Keeps the category priority of the former per-category searches
+    const int orderedCategories[] = { contextCategory, dataCategory, nodeCategory,
+                                      messageCategory, dynamicRouteCategory, functionCategory };
     
-    // Copy audio files
-    copyAudioFiles();
+    const auto& elements = HashMapHelpers::find (elementsByName, name);
     
-    // Generate code
-    generator.generate();
+    for (auto c : orderedCategories)
+        if (category & c)
+            for (auto emb : elements)
+                if (getElementCategory (emb) == c)
+                    return emb;
+    
+    return nullptr;
+}
+
+//==============================================================================
+
+RootWebAudioGraphPanel::RootWebAudioGraphPanel (Project& proj) : WebAudioGraphPanel (proj), project (proj)
+{
+    setPanelName ("Audio graph");
     
-    // Generate code files
-    auto writeToFile = [=](File f, String c)
+    // The elements report their changes, see elementChanged()
+    generator.setElementChangeTrackingEnabled (true);
+}
+
+void RootWebAudioGraphPanel::elementChanged (int graphId)
+{
+    generator.elementChanged (graphId);
+}
+
+void RootWebAudioGraphPanel::generateOutput (bool openInEditor)
+{
+    const File outputDir (getOutputDirectory());
+    auto snapshot = createGenerationSnapshot();
+    auto audioFiles = createAudioFilesSnapshot();
+    WeakReference<RootWebAudioGraphPanel> panel (this);
+    
+    // Transcoding can take a while too, it is done with the generation
+    generationThread.addJob ([this, snapshot, audioFiles, outputDir, openInEditor, panel]
     {
-        f.deleteFile();
+        WebAudioOutputWriter writer (outputDir);
         
-        FileOutputStream fos (f);
+        // Create directories
+        writer.prepareDirectories();
         
-        if (fos.openedOk())
-            fos.writeText (c, false, false, "\r\n");
-    };
+        // Copy audio files
+        const auto renamedFiles = syncAudioFiles (writer, *audioFiles);
+        const String audioBundleUrl (audioFiles->useAudioBundle ? WebAudioOutputWriter::getAudioBundleUrl() : String());
+        
+        // Generate code and code files
+        generateCode (*snapshot, renamedFiles, audioBundleUrl, false);
+        writer.writeGeneratedFiles (generator);
+        
+        // Open in internal code preview panel
+        if (openInEditor)
+        {
+            const String script (generator.getGeneratedScript());
+            
+            MessageManager::callAsync ([panel, script]
+            {
+                if (auto p = panel.get())
+                    p->showGeneratedScript (script);
+            });
+        }
+    });
+}
+
+std::shared_ptr<RootWebAudioGraphPanel::GenerationSnapshot> RootWebAudioGraphPanel::createGenerationSnapshot()
+{
+    auto snapshot = std::make_shared<GenerationSnapshot>();
     
-    if (generator.isUsingCoreLibrary())
-        writeToFile (outputDir.getChildFile ("js/wave.js"), generator.getCoreLibraryCode());
+    // Read along with the model: the elements changed after it can't reuse their last declarations
+    snapshot->changeCount = generator.getElementChangeCount();
+    createModelSnapshot (snapshot->model);
+    snapshot->optimize = project.isOptimizingGraph();
+    snapshot->eliminateDeadNodes = project.isEliminatingDeadNodes();
     
-    writeToFile (outputDir.getChildFile ("js/audio.js"), generator.getGeneratedScript());
-    writeToFile (outputDir.getChildFile ("index.html"), generator.getGeneratedHtmlPage());
+    return snapshot;
+}
+
+std::shared_ptr<RootWebAudioGraphPanel::AudioFilesSnapshot> RootWebAudioGraphPanel::createAudioFilesSnapshot() const
+{
+    auto snapshot = std::make_shared<AudioFilesSnapshot>();
     
-    writeToFile (outputDir.getChildFile ("style.css"),
-                 String::createStringFromData (BinaryData::style_css,
-                                               BinaryData::style_cssSize));
+    // Without the panel the list is unknown, the delivered files are then left where they are
+    if (auto filesPanel = project.findStaticPanelWithClass<AudioFilesPanel>())
+    {
+        for (auto f : filesPanel->getSubItems())
+            snapshot->files.add ({ f->getFile(), f->getOutputName() });
+        
+        snapshot->isListKnown = true;
+    }
     
-    // Open in internal code preview panel
-    if (! openInEditor)
-        return;
+    snapshot->transcodeSettings = project.getTranscodeSettings();
+    snapshot->transcodeCacheDirectory = getTranscodeCacheDirectory();
+    snapshot->useAudioBundle = project.isUsingAudioBundle();
     
+    return snapshot;
+}
+
+void RootWebAudioGraphPanel::generateCode (const GenerationSnapshot& snapshot, const StringPairArray& renamedFiles,
+                                           const String& audioBundleUrl, bool liveReload)
+{
+    generator.setRenamedAudioFiles (renamedFiles);
+    generator.setAudioBundleUrl (audioBundleUrl);
+    generator.setOptimizationEnabled (snapshot.optimize);
+    generator.setDeadNodeEliminationEnabled (snapshot.eliminateDeadNodes);
+    generator.setLiveReloadEnabled (liveReload);
+    generator.generate (snapshot.model, snapshot.changeCount);
+}
+
+void RootWebAudioGraphPanel::showGeneratedScript (const String& script)
+{
     if (auto editor = project.findStaticPanelWithClass<CodeEditorPanel>())
     {
         editor->getCodeEditor().setReadOnly (true);
-        editor->getCodeEditor().loadContent (generator.getGeneratedScript(), true);
+        editor->getCodeEditor().loadContent (script, true);
     }
 }
 
 void RootWebAudioGraphPanel::testInBrowser()
 {
-    generateOutput (true);
+    // Nothing is written for the preview: the server gets the generated files in memory and the
+    // audio files are served straight from their source, neither transcoded nor bundled.
+    // The pages already open reload what changed.
+    ReferenceCountedArray<LocalServer::ServedFile> audioFiles;
+    
+    if (auto filesPanel = project.findStaticPanelWithClass<AudioFilesPanel>())
+        for (auto f : filesPanel->getSubItems())
+            audioFiles.add (new LocalServer::ServedFile ("data/" + f->getOutputName(), f->getFile()));
+    
+    auto snapshot = createGenerationSnapshot();
+    WeakReference<RootWebAudioGraphPanel> panel (this);
+    
+    generationThread.addJob ([this, snapshot, audioFiles, panel]
+    {
+        generateCode (*snapshot, StringPairArray(), String(), true);
+        
+        ReferenceCountedArray<LocalServer::ServedFile> files;
+        
+        for (auto& f : generator.getOutputFiles())
+            files.add (new LocalServer::ServedFile (f.path, f.content));
+        
+        files.addArray (audioFiles);
+        const String script (generator.getGeneratedScript());
+        
+        MessageManager::callAsync ([panel, files, script]
+        {
+            if (auto p = panel.get())
+                p->serveGeneratedFiles (files, script);
+        });
+    });
+}
+
+void RootWebAudioGraphPanel::serveGeneratedFiles (const ReferenceCountedArray<LocalServer::ServedFile>& files,
+                                                  const String& script)
+{
+    showGeneratedScript (script);
     
     const auto outputDir = getOutputDirectory();
     
@@ -1689,6 +2148,11 @@ void RootWebAudioGraphPanel::testInBrowser()
     if (server == nullptr || server->getDirectory() != outputDir)
         server = new LocalServer (outputDir, port);
     
+    server->setFiles (files);
+    
+    if (server->hasConnectedPages())
+        return;
+    
     // If 8080 is already taken, the port may have changed
     port = server->getPortNumber();
     
@@ -1701,26 +2165,43 @@ File RootWebAudioGraphPanel::getOutputDirectory() const
     return project.getProjectDirectory().getChildFile ("output");
 }
 
+File RootWebAudioGraphPanel::getTranscodeCacheDirectory() const
+{
+    // Outside of the output directory, which only holds what is delivered
+    return project.getProjectDirectory().getChildFile ("cache").getChildFile ("transcoded");
+}
+
 void RootWebAudioGraphPanel::revealOutputDirectory() const
 {
     getOutputDirectory().revealToUser();
 }
 
-void RootWebAudioGraphPanel::copyAudioFiles()
+StringPairArray RootWebAudioGraphPanel::syncAudioFiles (WebAudioOutputWriter& writer, const AudioFilesSnapshot& audioFiles)
 {
-    const File outputDirectory = getOutputDirectory();
+    const AudioTranscoder transcoder (audioFiles.transcodeSettings, audioFiles.transcodeCacheDirectory);
+    const auto result = writer.syncAudioFiles (audioFiles.files, &transcoder, audioFiles.useAudioBundle,
+                                               audioFiles.isListKnown);
     
-    if (auto filesPanel = project.findStaticPanelWithClass<AudioFilesPanel>())
+    const StringArray nameCollisions (result.nameCollisions);
+    const StringArray untranscodedFiles (result.untranscodedFiles);
+    
+    if (! nameCollisions.isEmpty() || ! untranscodedFiles.isEmpty())
     {
-        for (auto f : filesPanel->getSubItems())
+        MessageManager::callAsync ([nameCollisions, untranscodedFiles]
         {
-            auto source = f->getFile();
-            auto dest = outputDirectory.getChildFile ("data/" + f->getOutputName());
-            
-            if (dest.exists() || ! source.exists())
-                continue;
+            if (! nameCollisions.isEmpty())
+                NativeMessageBox::showMessageBoxAsync (AlertWindow::AlertIconType::WarningIcon,
+                                                       "Some audio files were renamed",
+                                                       "Transcoded files can't share a name:" + String (newLine)
+                                                       + nameCollisions.joinIntoString (newLine));
             
-            source.copyFileTo (dest);
-        }
+            if (! untranscodedFiles.isEmpty())
+                NativeMessageBox::showMessageBoxAsync (AlertWindow::AlertIconType::WarningIcon,
+                                                       "Some audio files weren't transcoded",
+                                                       "These files are delivered as they are:" + String (newLine)
+                                                       + untranscodedFiles.joinIntoString (newLine));
+        });
     }
+    
+    return result.renamedFiles;
 }
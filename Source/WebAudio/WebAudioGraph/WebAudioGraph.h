@@ -12,6 +12,7 @@
 
 #include "GraphPanel.h"
 class WebAudioGraphPanel;
+class WebAudioContainer;
 
 // A GraphPanel with undoable add, remove, connect,...
 class WebAudioGraph : public GraphPanel
@@ -21,7 +22,7 @@ public:
     
     WebAudioGraphPanel& getOwnerPanel() { return owner; }
     
-    void containerMoved();
+    void containerMoved (WebAudioContainer* cont);
     
     void pastePreset (const String& xmlDoc, Point<int> offset);
     
@@ -40,6 +41,10 @@ public:
     bool canConnect (Pin* source, Pin* destination) const override;
     bool createConnectionBetween (Pin* source, Pin* dest, bool undoable) override;
     bool removeConnectionBetween (Pin* source, Pin* dest, bool undoable) override;
+    void embeddedComponentAdded (GraphEmbeddedComponent* comp) override;
+    void embeddedComponentRemoved (GraphEmbeddedComponent* comp) override;
+    void graphCleared() override;
+    void graphIdChanged (GraphEmbeddedComponent* comp, int previousId) override;
     
 private:
     static juce::Rectangle<int> findBoundingBox (const String& xmlDoc);
@@ -77,6 +82,7 @@ class WebAudioMessage;
 class WebAudioData;
 class WebAudioScript;
 class WebAudioComment;
+class WebAudioGraphModel;
 
 class WebAudioGraphPanel :  public Panel,
                             public GraphPanel::Listener,
@@ -165,6 +171,9 @@ public:
     
     Array<WebAudioComment*> getAllComments() const;
     
+    // Copies the current graph into a model the code generator can work on without the GUI
+    void createModelSnapshot (WebAudioGraphModel& model);
+    
     XmlElement* getAsXml() override;
     void restoreState (XmlElement* state) override;
     
@@ -176,6 +185,8 @@ public:
     }
     
     String getUnusedName (String desiredName) const;
+    Array<WebAudioEmbedded*> getAllElementsWithName (const String& name) const { return elementsByName[name]; }
+    void elementNameChanged (WebAudioEmbedded* element, const String& oldName);
     
     Point<int> getCenterOfVisibleGraphArea() const;
     
@@ -205,12 +216,35 @@ public:
     const Array<WeakReference<WebAudioContainer>>& getContainers() const { return containers; }
     void addContainer (WebAudioContainer* cont);
     void removeContainer (WebAudioContainer* cont);
+    void containerContentChanged (WebAudioContainer* cont, GraphEmbeddedComponent* comp, bool wasAdded);
+    Array<WebAudioContainer*> getAllContainersContaining (const GraphEmbeddedComponent* comp) const { return containersByContent[comp]; }
+    
+    // Containers that either contain this point or already contain the component
+    Array<WebAudioContainer*> getContainersToCheck (const GraphEmbeddedComponent* comp, Point<int> point) const;
+    
+    //==============================================================================
+    // Keeps the typed registries in sync with the graph content
+    void registerElement (GraphEmbeddedComponent* comp);
+    void unregisterElement (GraphEmbeddedComponent* comp);
+    void clearRegistries();
+    
+    // Called when something the generated code may depend on changed in an element:
+    // its properties, its options or its instance
+    virtual void elementChanged (int graphId) {}
     
 protected:
     Project& project;
     
 private:
     WebAudioEmbedded* findElementWithName (String name, int category = allCategories) const;
+    static int getElementCategory (const WebAudioEmbedded* element);
+    
+    void indexNameSuffix (const WebAudioEmbedded* element, const String& name);
+    void unindexNameSuffix (const WebAudioEmbedded* element, const String& name);
+    bool isNameSuffixShared (const WebAudioEmbedded* element, const String& name) const;
+    
+    // Names given by getUnusedName() can't be shared between these categories
+    enum { uniqueNameCategories = contextCategory | nodeCategory | dataCategory | dynamicRouteCategory | functionCategory };
     
     WeakReference<WebAudioGraphPanel>::Master masterReference;
     friend class WeakReference<WebAudioGraphPanel>;
@@ -222,6 +256,41 @@ private:
     
     Array<WeakReference<WebAudioContainer>> containers;
     
+    // Rank of each container in the containers array, which only ever appends
+    HashMap<const WebAudioContainer*, int> containerOrder;
+    int nextContainerOrder = 0;
+    
+    // Contexts and dynamic routes follow the containers array, the other
+    // registries follow the graph content.
+    Array<WebAudioContext*> contexts;
+    Array<WebAudioNode*> nodes;
+    Array<WebAudioDynamicRoute*> dynamicRoutes;
+    Array<WebAudioMessage*> messages;
+    Array<WebAudioData*> audioData;
+    Array<WebAudioScript*> scripts;
+    Array<WebAudioComment*> comments;
+    HashMap<const GraphEmbeddedComponent*, Array<WebAudioContainer*>> containersByContent;
+    HashMap<const GraphEmbeddedComponent*, Array<WebAudioDynamicRoute*>> dynamicRoutesByContent;
+    
+    HashMap<String, Array<WebAudioEmbedded*>> elementsByName;
+    
+    // Suffixes of the names getUnusedName() could give for a base name. The lowest free one is
+    // the lowest freed suffix if any, else the next one after those used without gaps.
+    struct NameSuffixes
+    {
+        int getLowestFree() const   { return freed.size() > 0 ? freed.getFirst() : nextFree; }
+        bool isEmpty() const        { return usedAboveNextFree.size() == 0 && freed.size() == nextFree - 2; }
+        
+        void use (int suffix);
+        void release (int suffix);
+        
+        int nextFree = 2;
+        SortedSet<int> freed;               // below nextFree
+        SortedSet<int> usedAboveNextFree;
+    };
+    
+    HashMap<String, NameSuffixes> usedSuffixesForBaseName;
+    
     WebAudioInstanceManager instanceManager;
     SharedResourcePointer<WebAudioDictionary> nodeDictionary;
         
@@ -230,6 +299,8 @@ private:
 
 //==============================================================================
 #include "WebAudioGraphCodeGenerator.h"
+#include "WebAudioOutputWriter.h"
+#include "AudioTranscoder.h"
 #include "JavascriptEditor.h"
 #include "WebServer.h"
 
@@ -244,17 +315,60 @@ public:
     void generateOutput (bool openInEditor = true);
     void testInBrowser();
     
+    void elementChanged (int graphId) override;
+    
     File getOutputDirectory() const;
     void revealOutputDirectory() const;
     
+    // The browser test's server, or nullptr if nothing was tested yet
+    LocalServer* getTestServer() const { return server.get(); }
+    
 private:
     WeakReference<RootWebAudioGraphPanel>::Master masterReference;
     friend class WeakReference<RootWebAudioGraphPanel>;
-    void copyAudioFiles();
+    
+    // The graph and project settings a generation works on, read on the message thread
+    struct GenerationSnapshot
+    {
+        WebAudioGraphModel model;
+        int64 changeCount = 0;
+        bool optimize = false;
+        bool eliminateDeadNodes = true;
+    };
+    
+    std::shared_ptr<GenerationSnapshot> createGenerationSnapshot();
+    
+    // The audio files to deliver and how, read on the message thread
+    struct AudioFilesSnapshot
+    {
+        Array<WebAudioOutputWriter::AudioFile> files;
+        bool isListKnown = false;
+        AudioTranscoder::Settings transcodeSettings;
+        File transcodeCacheDirectory;
+        bool useAudioBundle = false;
+    };
+    
+    std::shared_ptr<AudioFilesSnapshot> createAudioFilesSnapshot() const;
+    
+    // Called on generationThread. Its jobs run one after the other, so the generator's results
+    // can be read until the job returns.
+    void generateCode (const GenerationSnapshot& snapshot, const StringPairArray& renamedFiles,
+                       const String& audioBundleUrl, bool liveReload);
+    
+    void showGeneratedScript (const String& script);
+    void serveGeneratedFiles (const ReferenceCountedArray<LocalServer::ServedFile>& files, const String& script);
+    
+    // Called on generationThread, returns the audio files renamed by the transcoder
+    static StringPairArray syncAudioFiles (WebAudioOutputWriter& writer, const AudioFilesSnapshot& audioFiles);
+    File getTranscodeCacheDirectory() const;
     
     Project& project;
     ScopedPointer<LocalServer> server;
     WebAudioGraphGenerator generator;
     
+    // Generates the code without freezing the editor on large graphs. Declared after the
+    // generator, so that the running generation is finished before the generator is deleted.
+    ThreadPool generationThread { 1 };
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RootWebAudioGraphPanel)
 };
@@ -0,0 +1,361 @@
+#include "WebAudioGraphModel.h"
+#include "WebAudioGraphElementTypeNames.h"
+#include "HashMapHelpers.h"
+
+bool WebAudioGraphModel::Element::isContext() const             { return type == GraphElementType::audioContextType; }
+bool WebAudioGraphModel::Element::isDestinationNode() const     { return type == GraphElementType::audioDestinationNodeType; }
+bool WebAudioGraphModel::Element::isNode() const                { return type == GraphElementType::audioNodeType || isDestinationNode(); }
+bool WebAudioGraphModel::Element::isDynamicRoute() const        { return type == GraphElementType::dynamicRouteType; }
+bool WebAudioGraphModel::Element::isMessage() const             { return type == GraphElementType::messageType; }
+bool WebAudioGraphModel::Element::isScript() const              { return type == GraphElementType::scriptType; }
+bool WebAudioGraphModel::Element::isAudioData() const           { return type == GraphElementType::audioDataType; }
+
+Point<int> WebAudioGraphModel::Element::getContainmentAnchor() const
+{
+    // Same as WebAudioNode::checkContainers(): nodes are held by their title bar
+    // (GraphEmbeddedComponent's default height) whatever their folded state.
+    if (type == GraphElementType::audioNodeType)
+        return bounds.withHeight (22).getCentre();
+    
+    return bounds.getCentre();
+}
+
+bool WebAudioGraphModel::Connection::operator== (const Connection& other) const
+{
+    return sourceId == other.sourceId
+        && sourceIndex == other.sourceIndex
+        && sourcePlacement == other.sourcePlacement
+        && destId == other.destId
+        && destIndex == other.destIndex
+        && destPlacement == other.destPlacement;
+}
+
+//==============================================================================
+void WebAudioGraphModel::clear()
+{
+    elements.clearQuick();
+    connections.clearQuick();
+    elementIndexForGraphId.clear();
+    connectionsFromPin.clear();
+    connectionsToPin.clear();
+    nodesInContext.clear();
+    nodesInDynamicRoute.clear();
+    scriptsAndMessagesInDynamicRoute.clear();
+    pageTitle.clear();
+}
+
+void WebAudioGraphModel::addElement (const Element& element)
+{
+    elementIndexForGraphId.set (element.graphId, elements.size());
+    elements.add (element);
+    indexContainers (elements.size() - 1);
+}
+
+bool WebAudioGraphModel::addConnection (const Connection& connection)
+{
+    if (findElementWithGraphId (connection.sourceId) == nullptr
+        || findElementWithGraphId (connection.destId) == nullptr)
+        return false;
+    
+    auto& fromPin = connectionsFromPin.getReference (getPinKey (connection.sourceId, connection.sourcePlacement));
+    
+    for (auto i : fromPin)
+        if (connections.getReference (i) == connection)
+            return false;
+    
+    fromPin.add (connections.size());
+    connectionsToPin.getReference (getPinKey (connection.destId, connection.destPlacement)).add (connections.size());
+    connections.add (connection);
+    return true;
+}
+
+bool WebAudioGraphModel::loadFromXml (const XmlElement& xml)
+{
+    clear();
+    
+    if (! xml.hasTagName ("GraphPanel"))
+        return false;
+    
+    forEachXmlChildElementWithTagName (xml, e, "Embedded")
+    {
+        Element element;
+        element.graphId = e->getIntAttribute ("graphId");
+        element.type = e->getStringAttribute ("elementType");
+        element.name = e->getStringAttribute ("name");
+        element.interfaceName = e->getStringAttribute ("interface");
+        element.bounds.setBounds (e->getIntAttribute ("xpos"), e->getIntAttribute ("ypos"),
+                                  e->getIntAttribute ("width"), e->getIntAttribute ("height"));
+        element.colour = Colour::fromString (e->getStringAttribute ("backgroundColour"));
+        element.scriptContent = e->getStringAttribute ("editorContent");
+        element.linkedFileUuid = e->getStringAttribute ("linkedFile");
+        element.contextId = e->getIntAttribute ("contextGraphId", -1);
+        
+        if (auto options = e->getChildByName ("OPTIONS"))
+        {
+            element.hasInstance = true;
+            
+            for (int i = 0; i < options->getNumAttributes(); ++i)
+                element.options.add ({ options->getAttributeName (i), options->getAttributeValue (i) });
+        }
+        
+        addElement (element);
+    }
+    
+    forEachXmlChildElementWithTagName (xml, e, "Connection")
+    {
+        addConnection ({ e->getIntAttribute ("sourceId"),
+                         e->getIntAttribute ("sourceChannel"),
+                         static_cast<PinPlacement> (e->getIntAttribute ("sourcePlacement")),
+                         e->getIntAttribute ("destId"),
+                         e->getIntAttribute ("destChannel"),
+                         static_cast<PinPlacement> (e->getIntAttribute ("destPlacement")) });
+    }
+    
+    resolveContainers();
+    
+    return true;
+}
+
+void WebAudioGraphModel::resolveContainers()
+{
+    const auto contexts = getAllContexts();
+    const auto dynamicRoutes = getAllDynamicRoutes();
+    
+    for (auto& element : elements)
+    {
+        // Contexts are never contained and dynamic routes can only go in contexts,
+        // which only matters for the nodes
+        if (element.isContext() || element.isDynamicRoute())
+            continue;
+        
+        const auto anchor = element.getContainmentAnchor();
+        
+        if (element.isNode())
+        {
+            // The saved context wins as long as the node still lies in it
+            auto savedContext = findElementWithGraphId (element.contextId);
+            
+            if (savedContext == nullptr || ! savedContext->isContext() || ! savedContext->bounds.contains (anchor))
+            {
+                element.contextId = -1;
+                
+                for (auto ctx : contexts)
+                {
+                    if (ctx->bounds.contains (anchor))
+                    {
+                        element.contextId = ctx->graphId;
+                        break;
+                    }
+                }
+            }
+        }
+        else
+        {
+            element.contextId = -1;
+        }
+        
+        element.dynamicRouteIds.clearQuick();
+        
+        if (element.isDestinationNode())
+            continue;
+        
+        for (auto dr : dynamicRoutes)
+            if (dr->bounds.contains (anchor))
+                element.dynamicRouteIds.add (dr->graphId);
+    }
+    
+    nodesInContext.clear();
+    nodesInDynamicRoute.clear();
+    scriptsAndMessagesInDynamicRoute.clear();
+    
+    for (int i = 0; i < elements.size(); ++i)
+        indexContainers (i);
+}
+
+void WebAudioGraphModel::indexContainers (int elementIndex)
+{
+    const auto& element = elements.getReference (elementIndex);
+    
+    if (element.isNode())
+    {
+        nodesInContext.getReference (element.contextId).add (elementIndex);
+        
+        for (auto id : element.dynamicRouteIds)
+            nodesInDynamicRoute.getReference (id).add (elementIndex);
+    }
+    else if (element.isScript() || element.isMessage())
+    {
+        for (auto id : element.dynamicRouteIds)
+            scriptsAndMessagesInDynamicRoute.getReference (id).add (elementIndex);
+    }
+}
+
+//==============================================================================
+const WebAudioGraphModel::Element* WebAudioGraphModel::findElementWithGraphId (int graphId) const
+{
+    if (! elementIndexForGraphId.contains (graphId))
+        return nullptr;
+    
+    return &elements.getReference (elementIndexForGraphId[graphId]);
+}
+
+template <typename Predicate>
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllElementsWhere (Predicate predicate, bool sorted) const
+{
+    Array<const Element*> result;
+    
+    for (auto& element : elements)
+        if (predicate (element))
+            result.add (&element);
+    
+    if (sorted)
+        sortByPosition (result);
+    
+    return result;
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getIndexedElements (const HashMap<int, Array<int>>& index,
+                                                                                  int containerId, bool sorted) const
+{
+    const auto& indices = HashMapHelpers::find (index, containerId);
+    
+    Array<const Element*> result;
+    result.ensureStorageAllocated (indices.size());
+    
+    for (auto i : indices)
+        result.add (&elements.getReference (i));
+    
+    if (sorted)
+        sortByPosition (result);
+    
+    return result;
+}
+
+void WebAudioGraphModel::sortByPosition (Array<const Element*>& elementsToSort)
+{
+    ElementPositionComparator comparator;
+    elementsToSort.sort (comparator, true);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllContexts (bool sorted) const
+{
+    return getAllElementsWhere ([] (const Element& e) { return e.isContext(); }, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllNodesInContext (int contextId, bool sorted) const
+{
+    return getIndexedElements (nodesInContext, contextId, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllNodesWithoutContext (bool sorted) const
+{
+    return getAllNodesInContext (-1, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllDynamicRoutes (bool sorted) const
+{
+    return getAllElementsWhere ([] (const Element& e) { return e.isDynamicRoute(); }, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllNodesInDynamicRoute (int routeId, bool sorted) const
+{
+    return getIndexedElements (nodesInDynamicRoute, routeId, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllScriptsAndMessagesInDynamicRoute (int routeId, bool sorted) const
+{
+    return getIndexedElements (scriptsAndMessagesInDynamicRoute, routeId, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllScriptsAndMessagesAtRoot (bool sorted) const
+{
+    return getAllElementsWhere ([] (const Element& e)
+    {
+        return (e.isScript() || e.isMessage()) && e.dynamicRouteIds.isEmpty();
+    }, sorted);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllAudioData() const
+{
+    return getAllElementsWhere ([] (const Element& e) { return e.isAudioData(); }, false);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllScripts() const
+{
+    return getAllElementsWhere ([] (const Element& e) { return e.isScript(); }, false);
+}
+
+Array<const WebAudioGraphModel::Element*> WebAudioGraphModel::getAllConnected (const Element& element, PinPlacement placement) const
+{
+    const bool isOutput = (placement == pinOnBottom || placement == pinOnRight);
+    
+    const auto& indices = HashMapHelpers::find (isOutput ? connectionsFromPin : connectionsToPin,
+                                                getPinKey (element.graphId, placement));
+    
+    // Connections are grouped by pin, as the panel lists them pin after pin
+    Array<const Connection*> matching;
+    
+    for (auto i : indices)
+        matching.add (&connections.getReference (i));
+    
+    struct PinIndexComparator
+    {
+        PinIndexComparator (bool output) : isOutput (output) {}
+        
+        int compareElements (const Connection* first, const Connection* second) const
+        {
+            return isOutput ? first->sourceIndex - second->sourceIndex
+                            : first->destIndex - second->destIndex;
+        }
+        
+        const bool isOutput;
+    };
+    
+    PinIndexComparator comparator (isOutput);
+    matching.sort (comparator, true);
+    
+    Array<const Element*> result;
+    
+    for (auto c : matching)
+        if (auto other = findElementWithGraphId (isOutput ? c->destId : c->sourceId))
+            result.addIfNotAlreadyThere (other);
+    
+    return result;
+}
+
+String WebAudioGraphModel::getContextName (const Element& node) const
+{
+    if (auto ctx = findElementWithGraphId (node.contextId))
+        return ctx->name;
+    
+    return String();
+}
+
+void WebAudioGraphModel::findIdentifiersUsedInCode (HashMap<String, bool>& identifiers) const
+{
+    auto isIdentifierChar = [] (juce_wchar c) { return CharacterFunctions::isLetterOrDigit (c) || c == '_' || c == '$'; };
+    
+    for (auto& e : elements)
+    {
+        if (! (e.isScript() || e.isMessage()))
+            continue;
+        
+        const String& code = e.isScript() ? e.scriptContent : e.name;
+        
+        for (auto p = code.getCharPointer(); ! p.isEmpty();)
+        {
+            if (! isIdentifierChar (*p))
+            {
+                ++p;
+                continue;
+            }
+            
+            auto start = p;
+            
+            while (! p.isEmpty() && isIdentifierChar (*p))
+                ++p;
+            
+            identifiers.set (String (start, p), true);
+        }
+    }
+}
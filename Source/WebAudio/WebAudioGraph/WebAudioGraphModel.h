@@ -0,0 +1,152 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Plain data description of a WebAudio graph: elements, containment, options and connections.
+// It doesn't depend on any Component, so it can be filled from a live WebAudioGraphPanel or
+// directly from a saved project and be used by the code generator without any GUI.
+class WebAudioGraphModel
+{
+public:
+    // Same values as GraphEmbeddedComponent::Pin::Placement
+    enum PinPlacement
+    {
+        pinOnTop,
+        pinOnRight,
+        pinOnBottom,
+        pinOnLeft
+    };
+    
+    struct Option
+    {
+        String name;
+        String value;
+    };
+    
+    struct Element
+    {
+        bool isContext() const;
+        bool isNode() const;
+        bool isDestinationNode() const;
+        bool isDynamicRoute() const;
+        bool isMessage() const;
+        bool isScript() const;
+        bool isAudioData() const;
+        
+        // The point used to find out which containers hold this element
+        Point<int> getContainmentAnchor() const;
+        
+        int graphId = -1;
+        String type;
+        String name;
+        String interfaceName;
+        juce::Rectangle<int> bounds;
+        Colour colour;
+        
+        bool hasInstance = false;
+        Array<Option> options;
+        String scriptContent;
+        String linkedFileUuid;
+        
+        int contextId = -1;
+        Array<int> dynamicRouteIds;
+    };
+    
+    struct Connection
+    {
+        bool operator== (const Connection& other) const;
+        
+        int sourceId;
+        int sourceIndex;
+        PinPlacement sourcePlacement;
+        
+        int destId;
+        int destIndex;
+        PinPlacement destPlacement;
+    };
+    
+    WebAudioGraphModel() {}
+    
+    //==============================================================================
+    void clear();
+    
+    // Elements must be added before the connections that use them, with their containers set
+    void addElement (const Element& element);
+    bool addConnection (const Connection& connection);
+    
+    // Loads the content of a "GraphPanel" element as saved by GraphPanel::getStateAsXml().
+    // Containers are resolved from the elements' bounds.
+    bool loadFromXml (const XmlElement& graphPanelXml);
+    
+    void setPageTitle (const String& newTitle) { pageTitle = newTitle; }
+    const String& getPageTitle() const { return pageTitle; }
+    
+    //==============================================================================
+    int getNumElements() const { return elements.size(); }
+    const Element& getElement (int index) const { return elements.getReference (index); }
+    const Element* findElementWithGraphId (int graphId) const;
+    
+    const Array<Connection>& getConnections() const { return connections; }
+    
+    Array<const Element*> getAllContexts (bool sorted = false) const;
+    Array<const Element*> getAllNodesInContext (int contextId, bool sorted = false) const;
+    Array<const Element*> getAllNodesWithoutContext (bool sorted = false) const;
+    Array<const Element*> getAllDynamicRoutes (bool sorted = false) const;
+    Array<const Element*> getAllNodesInDynamicRoute (int routeId, bool sorted = false) const;
+    Array<const Element*> getAllScriptsAndMessagesInDynamicRoute (int routeId, bool sorted = false) const;
+    Array<const Element*> getAllScriptsAndMessagesAtRoot (bool sorted = false) const;
+    Array<const Element*> getAllAudioData() const;
+    Array<const Element*> getAllScripts() const;
+    
+    // Elements connected to the given element's pins with this placement, as GraphPanel::getAllConnected()
+    Array<const Element*> getAllConnected (const Element& element, PinPlacement placement) const;
+    
+    String getContextName (const Element& node) const;
+    
+    // Identifiers appearing in the scripts' code and in the messages: the nodes with these names
+    // may be used by the code at any time
+    void findIdentifiersUsedInCode (HashMap<String, bool>& identifiers) const;
+    
+    //==============================================================================
+    struct ElementPositionComparator
+    {
+        static int compareElements (const Element* first, const Element* second)
+        {
+            const int firstX = first->bounds.getX();
+            const int firstY = first->bounds.getY();
+            const int secondX = second->bounds.getX();
+            const int secondY = second->bounds.getY();
+            
+            return firstY < secondY ? -1 : firstY > secondY ? 1 : firstX < secondX ? -1 : firstX > secondX ? 1 : 0;
+        }
+    };
+    
+private:
+    template <typename Predicate>
+    Array<const Element*> getAllElementsWhere (Predicate predicate, bool sorted) const;
+    Array<const Element*> getIndexedElements (const HashMap<int, Array<int>>& index, int containerId, bool sorted) const;
+    static void sortByPosition (Array<const Element*>& elementsToSort);
+    
+    void resolveContainers();
+    void indexContainers (int elementIndex);
+    
+    static int64 getPinKey (int graphId, PinPlacement placement) { return (int64) graphId * 4 + placement; }
+    
+    Array<Element> elements;
+    Array<Connection> connections;
+    HashMap<int, int> elementIndexForGraphId;
+    
+    // Indices of the connections leaving and reaching each pin, in the connections' order
+    HashMap<int64, Array<int>> connectionsFromPin;
+    HashMap<int64, Array<int>> connectionsToPin;
+    
+    // Indices of the elements held by each container, in the elements' order.
+    // The nodes without context are listed under -1.
+    HashMap<int, Array<int>> nodesInContext;
+    HashMap<int, Array<int>> nodesInDynamicRoute;
+    HashMap<int, Array<int>> scriptsAndMessagesInDynamicRoute;
+    
+    String pageTitle;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WebAudioGraphModel)
+};
@@ -49,7 +49,7 @@ int WebAudioNodeInstance::getNumReferencesCurrentlyInGraph() const
 void WebAudioNodeInstance::optionsChanged()
 {
     for (auto n : references)
-        n->refreshOptionsTree();
+        n->instanceOptionsChanged();
 }
 
 //==============================================================================
@@ -75,6 +75,7 @@ WebAudioNodeInstance* WebAudioInstanceManager::addReference (WebAudioInspectable
     
     auto newInstance = new WebAudioNodeInstance (name, interf, node);
     instances.add (newInstance);
+    instancesByName.set (name, newInstance);
     node->setInstance (newInstance);
     
     return newInstance;
@@ -112,6 +113,7 @@ WebAudioNodeInstance* WebAudioInstanceManager::updateReference (WebAudioInspecta
     auto newInstance = new WebAudioNodeInstance (name, interf, node, options);
     //newInstance->getOptions();
     instances.add (newInstance);
+    instancesByName.set (name, newInstance);
     node->setInstance (newInstance);
     
     return newInstance;
@@ -127,15 +129,14 @@ void WebAudioInstanceManager::removeReference (WebAudioInspectableElement* node)
         instance->references.removeFirstMatchingValue (node);
         
         if (instance->references.isEmpty())
+        {
+            instancesByName.remove (instance->getName());
             instances.removeObject (instance);
+        }
     }
 }
 
 WebAudioNodeInstance* WebAudioInstanceManager::findInstanceWithName (String variableName) const
 {
-    for (auto instance : instances)
-        if (instance->getName() == variableName)
-            return instance;
-    
-    return nullptr;
+    return instancesByName[variableName];
 }
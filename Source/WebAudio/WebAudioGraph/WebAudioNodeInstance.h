@@ -67,6 +67,7 @@ public:
     
 private:
     OwnedArray<WebAudioNodeInstance> instances;
+    HashMap<String, WebAudioNodeInstance*> instancesByName;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WebAudioInstanceManager)
 };
@@ -0,0 +1,519 @@
+#include "HttpServer.h"
+
+#if ! JUCE_WINDOWS
+ #include <poll.h>
+#endif
+
+String HttpServer::Request::getParameter (const String& name, const String& fallback) const
+{
+    for (auto& pair : StringArray::fromTokens (query, "&", String()))
+        if (URL::removeEscapeChars (pair.upToFirstOccurrenceOf ("=", false, false)) == name)
+            return URL::removeEscapeChars (pair.fromFirstOccurrenceOf ("=", false, false).replaceCharacter ('+', ' '));
+    
+    return fallback;
+}
+
+bool HttpServer::Request::wantsKeepAlive() const
+{
+    const String connection (getHeader ("Connection"));
+    
+    if (protocol == "HTTP/1.1")
+        return ! connection.containsIgnoreCase ("close");
+    
+    return connection.containsIgnoreCase ("keep-alive");
+}
+
+void HttpServer::Response::setBodyStream (InputStream* stream, int64 numBytes)
+{
+    bodyStream = stream;
+    bodyStreamLength = numBytes;
+}
+
+//==============================================================================
+// A connection waiting for its next request, and the bytes received for it so far
+struct HttpServer::Connection
+{
+    Connection (StreamingSocket* s)
+        : socket (s), requestStartTime (Time::getMillisecondCounterHiRes()), lastActivityTime (requestStartTime)
+    {
+    }
+    
+    // Reads what already arrived. Returns false when the connection was closed or broke.
+    bool receive()
+    {
+        char buffer[4096];
+        
+        while (received.getSize() <= (size_t) maxHeaderSize && socket->waitUntilReady (true, 0) == 1)
+        {
+            const int numRead = socket->read (buffer, sizeof (buffer), false);
+            
+            if (numRead <= 0)
+                return false;
+            
+            lastActivityTime = Time::getMillisecondCounterHiRes();
+            
+            if (received.getSize() == 0 && numRequests > 0)
+                requestStartTime = lastActivityTime;
+            
+            received.append (buffer, (size_t) numRead);
+        }
+        
+        return true;
+    }
+    
+    // Size of the request head at the start of the received bytes, blank line included, or 0 if
+    // it isn't complete yet. Only the bytes received since the last call are searched.
+    size_t findEndOfHead()
+    {
+        const auto data = static_cast<const char*> (received.getData());
+        const size_t size = received.getSize();
+        
+        for (size_t i = numScanned >= 3 ? numScanned - 3 : 0; i + 4 <= size; ++i)
+            if (memcmp (data + i, "\r\n\r\n", 4) == 0)
+                return i + 4;
+        
+        numScanned = size;
+        return 0;
+    }
+    
+    // Drops a request head: what follows is the start of the next request
+    void consume (size_t numBytes)
+    {
+        received.removeSection (0, numBytes);
+        numScanned = 0;
+    }
+    
+    bool hasTimedOut (double now) const
+    {
+        // A kept-alive connection waiting for its next request is given less time
+        const bool isIdle = numRequests > 0 && received.getSize() == 0;
+        return now - lastActivityTime > (isIdle ? keepAliveTimeoutMs : readTimeoutMs);
+    }
+    
+    ScopedPointer<StreamingSocket> socket;
+    MemoryBlock received;
+    size_t numScanned = 0;
+    double requestStartTime;
+    double lastActivityTime;
+    int numRequests = 0;
+};
+
+//==============================================================================
+class HttpServer::RequestJob   : public ThreadPoolJob
+{
+public:
+    RequestJob (HttpServer& s, Connection* c, const Request& r)
+        : ThreadPoolJob ("HTTP request"), server (s), connection (c), request (r)
+    {
+        ++server.numConnectionsInWorkers;
+        server.addSocketInWorkers (connection->socket);
+    }
+    
+    ~RequestJob()
+    {
+        // Jobs removed before running, or whose connection was closed, still hold their socket
+        if (connection != nullptr)
+            server.removeSocketInWorkers (connection->socket);
+        
+        --server.numConnectionsInWorkers;
+    }
+    
+    JobStatus runJob() override
+    {
+        Response response;
+        Stats stats;
+        
+        server.handler.handleRequest (request, response);
+        
+        // Only small responses keep the connection: large downloads would hold it for long anyway
+        const bool keepAlive = ! response.keepConnection
+                            && request.wantsKeepAlive()
+                            && response.bodyStream == nullptr
+                            && response.body.getDataSize() <= (size_t) maxKeepAliveBodySize
+                            && connection->numRequests + 1 < maxRequestsPerConnection;
+        
+        auto& socket = *connection->socket;
+        const bool sent = sendResponse (socket, request, response, keepAlive, connection->requestStartTime, stats, *this);
+        
+        stats.totalTimeMs = Time::getMillisecondCounterHiRes() - connection->requestStartTime;
+        server.handler.requestServed (request, response, stats);
+        server.removeSocketInWorkers (&socket);
+        
+        if (shouldExit())
+        {
+            socket.close();
+        }
+        else if (response.keepConnection && socket.isConnected())
+        {
+            server.handler.connectionKept (request, connection->socket.release());
+        }
+        else if (keepAlive && sent)
+        {
+            ++connection->numRequests;
+            connection->lastActivityTime = Time::getMillisecondCounterHiRes();
+            server.connectionIdle (connection.release());
+        }
+        else
+        {
+            socket.close();
+        }
+        
+        return jobHasFinished;
+    }
+    
+private:
+    HttpServer& server;
+    ScopedPointer<Connection> connection;
+    const Request request;
+};
+
+//==============================================================================
+HttpServer::HttpServer (Handler& h, int numWorkersToUse)
+    : Thread ("HTTP server"), handler (h), workers (numWorkersToUse), numWorkers (numWorkersToUse)
+{
+    wakeUpSocket.bindToPort (0, "127.0.0.1");
+}
+
+HttpServer::~HttpServer()
+{
+    stop();
+}
+
+bool HttpServer::start (int portNumber)
+{
+    stop();
+    
+    if (! listener.createListener (portNumber))
+        return false;
+    
+    startThread();
+    return true;
+}
+
+void HttpServer::stop()
+{
+    signalThreadShouldExit();
+    listener.close();
+    wakeUp();
+    stopThread (-1);
+    
+    // No new jobs are added now. Closing their sockets ends the writes they are blocked in, and
+    // the jobs interrupted between two chunks return as soon as they see they should exit.
+    {
+        const ScopedLock sl (socketsInWorkersLock);
+        
+        for (auto socket : socketsInWorkers)
+            socket->close();
+    }
+    
+    workers.removeAllJobs (true, -1);
+    
+    connections.clear();
+    
+    const ScopedLock sl (idleConnectionsLock);
+    idleConnections.clear();
+}
+
+void HttpServer::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const ScopedLock sl (idleConnectionsLock);
+            
+            while (! idleConnections.isEmpty())
+                connections.add (idleConnections.removeAndReturn (0));
+        }
+        
+        // Without the wake-up socket, the connections given back by the workers are only
+        // noticed between two waits, which are then kept short
+        const bool canBeWokenUp = wakeUpSocket.getRawSocketHandle() >= 0;
+        const int timeoutMs = canBeWokenUp || numConnectionsInWorkers.get() == 0 ? idleWaitMs : pollIntervalMs;
+        bool hasNewConnection = false;
+        
+        if (! waitForActivity (timeoutMs, hasNewConnection))
+            break;
+        
+        if (hasNewConnection)
+        {
+            if (auto socket = listener.waitForNextConnection())
+                addConnection (new Connection (socket));
+            else if (! listener.isConnected())
+                break;
+        }
+        
+        readRequests();
+    }
+}
+
+bool HttpServer::waitForActivity (int timeoutMs, bool& hasNewConnection)
+{
+   #if JUCE_WINDOWS
+    using PollDescriptor = WSAPOLLFD;
+   #else
+    using PollDescriptor = pollfd;
+   #endif
+    
+    // poll() rather than select(), whose sets can't hold more than FD_SETSIZE sockets
+    HeapBlock<PollDescriptor> descriptors ((size_t) connections.size() + 2, true);
+    int numDescriptors = 0;
+    
+    auto add = [&] (int handle)
+    {
+        if (handle < 0)
+            return;
+        
+        auto& d = descriptors[numDescriptors++];
+        d.fd = (decltype (d.fd)) handle;
+        d.events = POLLIN;
+    };
+    
+    if (listener.getRawSocketHandle() < 0)
+        return false;
+    
+    add (listener.getRawSocketHandle());
+    add (wakeUpSocket.getRawSocketHandle());
+    
+    for (auto c : connections)
+        add (c->socket->getRawSocketHandle());
+   
+   #if JUCE_WINDOWS
+    const int result = WSAPoll (descriptors, (ULONG) numDescriptors, timeoutMs);
+   #else
+    const int result = poll (descriptors, (nfds_t) numDescriptors, timeoutMs);
+   #endif
+    
+    if (result < 0)
+        return listener.isConnected();
+    
+    if ((descriptors[0].revents & (POLLERR | POLLNVAL)) != 0)
+        return false;
+    
+    hasNewConnection = (descriptors[0].revents & POLLIN) != 0;
+    
+    // Only the wake-up matters, not what was written
+    char buffer[64];
+    
+    while (wakeUpSocket.waitUntilReady (true, 0) == 1 && wakeUpSocket.read (buffer, sizeof (buffer), false) > 0)
+    {}
+    
+    return true;
+}
+
+void HttpServer::wakeUp()
+{
+    const char byte = 0;
+    
+    // DatagramSocket::write() isn't safe to call from several threads at once
+    const ScopedLock sl (idleConnectionsLock);
+    
+    if (wakeUpSocket.getRawSocketHandle() >= 0)
+        wakeUpSocket.write ("127.0.0.1", wakeUpSocket.getBoundPort(), &byte, 1);
+}
+
+void HttpServer::addConnection (Connection* connection)
+{
+    if (connections.size() >= maxWaitingConnections)
+    {
+        sendError (*connection->socket, 503);
+        delete connection;
+        return;
+    }
+    
+    connections.add (connection);
+}
+
+void HttpServer::connectionIdle (Connection* connection)
+{
+    {
+        const ScopedLock sl (idleConnectionsLock);
+        idleConnections.add (connection);
+    }
+    
+    wakeUp();
+}
+
+void HttpServer::addSocketInWorkers (StreamingSocket* socket)
+{
+    const ScopedLock sl (socketsInWorkersLock);
+    socketsInWorkers.add (socket);
+}
+
+void HttpServer::removeSocketInWorkers (StreamingSocket* socket)
+{
+    const ScopedLock sl (socketsInWorkersLock);
+    socketsInWorkers.removeFirstMatchingValue (socket);
+}
+
+void HttpServer::readRequests()
+{
+    const double now = Time::getMillisecondCounterHiRes();
+    
+    for (int i = 0; i < connections.size();)
+    {
+        auto& connection = *connections.getUnchecked (i);
+        
+        if (! connection.receive())
+        {
+            connections.remove (i);
+            continue;
+        }
+        
+        const size_t headSize = connection.findEndOfHead();
+        
+        if (headSize == 0)
+        {
+            // Requests with a body aren't expected, the head alone must fit
+            if (connection.received.getSize() > (size_t) maxHeaderSize)
+            {
+                sendError (*connection.socket, 400);
+                connections.remove (i);
+            }
+            else if (connection.hasTimedOut (now))
+            {
+                connections.remove (i);
+            }
+            else
+            {
+                ++i;
+            }
+            
+            continue;
+        }
+        
+        Request request;
+        const bool isValid = parseRequest (static_cast<const char*> (connection.received.getData()), headSize, request);
+        connection.consume (headSize);
+        
+        if (! isValid)
+        {
+            sendError (*connection.socket, 400);
+            connections.remove (i);
+            continue;
+        }
+        
+        // The queue of the pool is bounded: clients are told to come back rather than wait
+        if (workers.getNumJobs() >= numWorkers + maxQueuedRequests)
+        {
+            sendError (*connection.socket, 503);
+            connections.remove (i);
+            continue;
+        }
+        
+        workers.addJob (new RequestJob (*this, connections.removeAndReturn (i), request), true);
+    }
+}
+
+//==============================================================================
+bool HttpServer::parseRequest (const char* head, size_t headSize, Request& request)
+{
+    auto lines = StringArray::fromLines (String::fromUTF8 (head, (int) headSize).trimEnd());
+    auto requestLine = StringArray::fromTokens (lines[0], " ", String());
+    
+    if (requestLine.size() < 2)
+        return false;
+    
+    const String target (requestLine[1]);
+    
+    request.method = requestLine[0].toUpperCase();
+    request.protocol = requestLine.size() > 2 ? requestLine[2].toUpperCase() : String ("HTTP/1.0");
+    request.path = URL::removeEscapeChars (target.upToFirstOccurrenceOf ("?", false, false));
+    request.query = target.fromFirstOccurrenceOf ("?", false, false);
+    
+    for (int i = 1; i < lines.size(); ++i)
+        if (lines[i].containsChar (':'))
+            request.headers.set (lines[i].upToFirstOccurrenceOf (":", false, false).trim(),
+                                 lines[i].fromFirstOccurrenceOf (":", false, false).trim());
+    
+    return true;
+}
+
+bool HttpServer::sendResponse (StreamingSocket& socket, const Request& request, Response& response,
+                               bool keepAlive, double startTime, Stats& stats, ThreadPoolJob& job)
+{
+    const bool hasBodyStream = response.bodyStream != nullptr;
+    const int64 contentLength = hasBodyStream ? response.bodyStreamLength : (int64) response.body.getDataSize();
+    
+    MemoryOutputStream head;
+    head << "HTTP/1.1 " << response.code << " " << getStatusText (response.code) << "\r\n";
+    
+    for (auto& name : response.headers.getAllKeys())
+        head << name << ": " << response.headers[name] << "\r\n";
+    
+    // A kept connection's body only ends when it is closed
+    if (response.keepConnection)
+        head << "\r\n";
+    else if (keepAlive)
+        head << "Content-Length: " << String (contentLength) << "\r\n"
+             << "Connection: keep-alive\r\n"
+             << "Keep-Alive: timeout=" << String ((int) keepAliveTimeoutMs / 1000) << "\r\n\r\n";
+    else
+        head << "Content-Length: " << String (contentLength) << "\r\n" << "Connection: close\r\n\r\n";
+    
+    const int headSize = socket.write (head.getData(), (int) head.getDataSize());
+    stats.timeToFirstByteMs = Time::getMillisecondCounterHiRes() - startTime;
+    
+    if (headSize < 0)
+        return false;
+    
+    stats.bytesSent += headSize;
+    
+    if (request.method == "HEAD")
+        return true;
+    
+    if (! hasBodyStream)
+    {
+        const int bodySize = socket.write (response.body.getData(), (int) response.body.getDataSize());
+        stats.bytesSent += jmax (0, bodySize);
+        return bodySize == (int) response.body.getDataSize();
+    }
+    
+    // Large files are never held in memory as a whole
+    HeapBlock<char> chunk (chunkSize);
+    
+    for (int64 remaining = contentLength; remaining > 0;)
+    {
+        // The server is stopping: the client gets a truncated body
+        if (job.shouldExit())
+            return false;
+        
+        const int numRead = response.bodyStream->read (chunk, (int) jmin ((int64) chunkSize, remaining));
+        
+        if (numRead <= 0 || socket.write (chunk, numRead) < 0)
+            return false;
+        
+        stats.bytesSent += numRead;
+        remaining -= numRead;
+    }
+    
+    return true;
+}
+
+void HttpServer::sendError (StreamingSocket& socket, int code)
+{
+    String head ("HTTP/1.1 " + String (code) + " " + getStatusText (code) + "\r\n");
+    
+    if (code == 503)
+        head << "Retry-After: 1\r\n";
+    
+    head << "Content-Length: 0\r\nConnection: close\r\n\r\n";
+    socket.write (head.toRawUTF8(), (int) head.getNumBytesAsUTF8());
+    socket.close();
+}
+
+String HttpServer::getStatusText (int code)
+{
+    switch (code)
+    {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+    }
+}
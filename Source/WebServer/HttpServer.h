@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Minimal HTTP/1.1 server. A thread waits on the listener and all the waiting connections at
+// once, accepts the connections and reads their request heads as the bytes arrive, then hands the complete requests to a bounded pool of workers, which let the
+// handler fill the response and send it. Workers are never held by a slow or idle connection:
+// connections kept alive after a small response go back to the accepting thread until their next
+// request. When too many requests are waiting for a worker, new ones are answered with a 503.
+// Connections the handler wants to keep (e.g. event streams) are given to it once the response is sent.
+class HttpServer   : private Thread
+{
+public:
+    struct Request
+    {
+        String getHeader (const String& name) const     { return headers[name]; }
+        String getParameter (const String& name, const String& fallback = String()) const;
+        
+        // HTTP/1.1 connections stay open unless they ask otherwise, HTTP/1.0 ones only if they ask to
+        bool wantsKeepAlive() const;
+        
+        String method;
+        String protocol;        // e.g. "HTTP/1.1"
+        String path;            // unescaped, without the query string
+        String query;
+        StringPairArray headers;
+    };
+    
+    struct Response
+    {
+        void setHeader (const String& name, const String& value)   { headers.set (name, value); }
+        
+        // Body sent in chunks from the stream, which is only read while sending
+        void setBodyStream (InputStream* stream, int64 numBytes);
+        
+        int code = 200;
+        StringPairArray headers;
+        MemoryOutputStream body;
+        
+        // The response is then sent without a Content-Length and the connection is given to
+        // Handler::connectionKept() instead of being closed
+        bool keepConnection = false;
+        ScopedPointer<InputStream> bodyStream;
+        int64 bodyStreamLength = 0;
+    };
+    
+    // How a response was sent. Times are measured from the connection being accepted, or from the
+    // first bytes of the request on a kept-alive connection.
+    struct Stats
+    {
+        int64 bytesSent = 0;
+        double timeToFirstByteMs = 0.0;
+        double totalTimeMs = 0.0;
+    };
+    
+    struct Handler
+    {
+        virtual ~Handler() {}
+        
+        // Called on a worker thread. Sets the response's code, headers and body.
+        virtual void handleRequest (const Request& request, Response& response) = 0;
+        
+        // Called on the worker thread once the response is sent, or failed to be
+        virtual void requestServed (const Request& request, const Response& response, const Stats& stats) {}
+        
+        // Called on the worker thread once a response with keepConnection set is sent.
+        // Takes ownership of the connection.
+        virtual void connectionKept (const Request& request, StreamingSocket* connection) { delete connection; }
+    };
+    
+    HttpServer (Handler& handler, int numWorkers);
+    ~HttpServer();
+    
+    // Listens on all interfaces so that devices of the local network can connect
+    bool start (int portNumber);
+    
+    // Closes the connections of the requests being served, and waits for their workers to return
+    void stop();
+    
+    bool isRunning() const { return isThreadRunning(); }
+    
+private:
+    struct Connection;
+    class RequestJob;
+    
+    void run() override;
+    
+    // Waits until the listener, a waiting connection or the wake-up socket has something to read,
+    // or the timeout expires. Returns false if the listener was closed.
+    bool waitForActivity (int timeoutMs, bool& hasNewConnection);
+    void wakeUp();
+    
+    void addConnection (Connection* connection);
+    void readRequests();
+    
+    // Called by the workers once a kept-alive connection's response is sent
+    void connectionIdle (Connection* connection);
+    
+    // The sockets handed to the workers, which stop() closes. A worker removes its socket before
+    // giving it to the handler or back to the thread.
+    void addSocketInWorkers (StreamingSocket* socket);
+    void removeSocketInWorkers (StreamingSocket* socket);
+    
+    static bool parseRequest (const char* head, size_t headSize, Request& request);
+    static bool sendResponse (StreamingSocket& socket, const Request& request, Response& response,
+                              bool keepAlive, double startTime, Stats& stats, ThreadPoolJob& job);
+    static void sendError (StreamingSocket& socket, int code);
+    static String getStatusText (int code);
+    
+    Handler& handler;
+    StreamingSocket listener;
+    ThreadPool workers;
+    const int numWorkers;
+    Atomic<int> numConnectionsInWorkers;
+    
+    OwnedArray<Connection> connections;         // waiting for a request, only used by the thread
+    OwnedArray<Connection> idleConnections;     // given back by the workers
+    CriticalSection idleConnectionsLock;
+    
+    Array<StreamingSocket*> socketsInWorkers;
+    CriticalSection socketsInWorkersLock;
+    
+    // Written to by the workers to wake the thread up when they give a connection back
+    DatagramSocket wakeUpSocket;
+    
+    enum
+    {
+        maxHeaderSize = 32768,
+        readTimeoutMs = 10000,
+        keepAliveTimeoutMs = 5000,
+        maxRequestsPerConnection = 100,
+        maxKeepAliveBodySize = 262144,
+        maxWaitingConnections = 256,
+        maxQueuedRequests = 64,
+        pollIntervalMs = 5,     // only used when the wake-up socket couldn't be bound
+        idleWaitMs = 500,
+        chunkSize = 65536
+    };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HttpServer)
+};
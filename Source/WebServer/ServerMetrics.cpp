@@ -0,0 +1,130 @@
+#include "ServerMetrics.h"
+
+void ServerMetrics::Summary::add (const Request& request)
+{
+    ++numRequests;
+    
+    if (request.status >= 400)
+        ++numErrors;
+    
+    lastStatus = request.status;
+    bytesSent += request.bytesSent;
+    sumTimeToFirstByteMs += request.timeToFirstByteMs;
+    maxTimeToFirstByteMs = jmax (maxTimeToFirstByteMs, request.timeToFirstByteMs);
+    sumTotalTimeMs += request.totalTimeMs;
+    maxTotalTimeMs = jmax (maxTotalTimeMs, request.totalTimeMs);
+}
+
+var ServerMetrics::Summary::toJSON() const
+{
+    auto o = new DynamicObject();
+    
+    if (path.isNotEmpty())
+        o->setProperty ("path", path);
+    
+    o->setProperty ("requests", numRequests);
+    o->setProperty ("errors", numErrors);
+    o->setProperty ("lastStatus", lastStatus);
+    o->setProperty ("bytesSent", bytesSent);
+    o->setProperty ("avgTimeToFirstByteMs", getAverageTimeToFirstByteMs());
+    o->setProperty ("maxTimeToFirstByteMs", maxTimeToFirstByteMs);
+    o->setProperty ("avgTotalTimeMs", getAverageTotalTimeMs());
+    o->setProperty ("maxTotalTimeMs", maxTotalTimeMs);
+    
+    return var (o);
+}
+
+//==============================================================================
+void ServerMetrics::add (const Request& request)
+{
+    const ScopedLock sl (lock);
+    
+    if (! summaryIndexForPath.contains (request.path))
+    {
+        Summary s;
+        s.path = request.path;
+        
+        summaryIndexForPath.set (request.path, summaries.size());
+        summaries.add (s);
+    }
+    
+    summaries.getReference (summaryIndexForPath[request.path]).add (request);
+    total.add (request);
+    
+    recentRequests.add (request);
+    
+    if (recentRequests.size() > numRecentRequests)
+        recentRequests.removeRange (0, recentRequests.size() - numRecentRequests);
+}
+
+void ServerMetrics::clear()
+{
+    const ScopedLock sl (lock);
+    
+    summaries.clearQuick();
+    summaryIndexForPath.clear();
+    total = Summary();
+    recentRequests.clearQuick();
+}
+
+Array<ServerMetrics::Summary> ServerMetrics::getSummaries() const
+{
+    struct PathComparator
+    {
+        static int compareElements (const Summary& first, const Summary& second)
+        {
+            return first.path.compareNatural (second.path);
+        }
+    };
+    
+    Array<Summary> result;
+    
+    {
+        const ScopedLock sl (lock);
+        result = summaries;
+    }
+    
+    PathComparator comparator;
+    result.sort (comparator);
+    return result;
+}
+
+ServerMetrics::Summary ServerMetrics::getTotal() const
+{
+    const ScopedLock sl (lock);
+    return total;
+}
+
+Array<ServerMetrics::Request> ServerMetrics::getRecentRequests() const
+{
+    const ScopedLock sl (lock);
+    return recentRequests;
+}
+
+var ServerMetrics::toJSON() const
+{
+    Array<var> paths;
+    
+    for (auto& s : getSummaries())
+        paths.add (s.toJSON());
+    
+    Array<var> recent;
+    
+    for (auto& r : getRecentRequests())
+    {
+        auto o = new DynamicObject();
+        o->setProperty ("path", r.path);
+        o->setProperty ("status", r.status);
+        o->setProperty ("bytesSent", r.bytesSent);
+        o->setProperty ("timeToFirstByteMs", r.timeToFirstByteMs);
+        o->setProperty ("totalTimeMs", r.totalTimeMs);
+        recent.add (var (o));
+    }
+    
+    auto result = new DynamicObject();
+    result->setProperty ("total", getTotal().toJSON());
+    result->setProperty ("paths", paths);
+    result->setProperty ("recent", recent);
+    
+    return var (result);
+}
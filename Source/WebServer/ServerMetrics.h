@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Sizes and timings of the requests answered by LocalServer, aggregated by path. Requests are
+// added by the server's workers while the app reads the aggregates, hence the lock.
+class ServerMetrics
+{
+public:
+    struct Request
+    {
+        String path;
+        int status = 0;
+        int64 bytesSent = 0;
+        double timeToFirstByteMs = 0.0;     // both measured from the connection being accepted
+        double totalTimeMs = 0.0;
+    };
+    
+    struct Summary
+    {
+        void add (const Request& request);
+        
+        double getAverageTimeToFirstByteMs() const  { return numRequests > 0 ? sumTimeToFirstByteMs / numRequests : 0.0; }
+        double getAverageTotalTimeMs() const        { return numRequests > 0 ? sumTotalTimeMs / numRequests : 0.0; }
+        
+        var toJSON() const;
+        
+        String path;
+        int numRequests = 0;
+        int numErrors = 0;
+        int lastStatus = 0;
+        int64 bytesSent = 0;
+        double sumTimeToFirstByteMs = 0.0;
+        double maxTimeToFirstByteMs = 0.0;
+        double sumTotalTimeMs = 0.0;
+        double maxTotalTimeMs = 0.0;
+    };
+    
+    ServerMetrics() {}
+    
+    void add (const Request& request);
+    void clear();
+    
+    // Sorted by path
+    Array<Summary> getSummaries() const;
+    Summary getTotal() const;
+    Array<Request> getRecentRequests() const;
+    
+    // {"total": {...}, "paths": [{...}, ...], "recent": [{...}, ...]}
+    var toJSON() const;
+    
+private:
+    CriticalSection lock;
+    Array<Summary> summaries;
+    HashMap<String, int> summaryIndexForPath;
+    Summary total;
+    Array<Request> recentRequests;
+    
+    enum { numRecentRequests = 100 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ServerMetrics)
+};
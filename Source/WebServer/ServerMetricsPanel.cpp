@@ -0,0 +1,125 @@
+#include "ServerMetricsPanel.h"
+#include "Project.h"
+#include "WebAudioGraph.h"
+
+ServerMetricsPanel::ServerMetricsPanel (Project& p) : Panel (&p.getPanelManager()), project (p)
+{
+    addAndMakeVisible (table);
+    table.setModel (this);
+    
+    auto& header = table.getHeader();
+    header.addColumn ("Path", pathColumn, 120);
+    header.addColumn ("Requests", requestsColumn, 50);
+    header.addColumn ("Status", statusColumn, 40);
+    header.addColumn ("Sent", bytesColumn, 60);
+    header.addColumn ("First byte", timeToFirstByteColumn, 60);
+    header.addColumn ("Total", totalTimeColumn, 60);
+    header.addColumn ("Max", maxTotalTimeColumn, 60);
+    header.setStretchToFitActive (true);
+    table.setHeaderHeight (22);
+    
+    addAndMakeVisible (totalLabel);
+    totalLabel.setFont (Font (12.0f));
+    
+    setPanelName ("Server");
+    sendPanelBorderToFront();
+    
+    startTimer (timerInterval);
+}
+
+void ServerMetricsPanel::resized()
+{
+    Panel::resized();
+    
+    juce::Rectangle<int> r (getLocalBounds().withTrimmedTop (getHeaderHeight()));
+    
+    totalLabel.setBounds (r.removeFromBottom (24));
+    table.setBounds (r);
+}
+
+void ServerMetricsPanel::timerCallback()
+{
+    auto graphPanel = project.findStaticPanelWithClass<RootWebAudioGraphPanel>();
+    auto server = graphPanel != nullptr ? graphPanel->getTestServer() : nullptr;
+    
+    if (server == nullptr)
+    {
+        if (! summaries.isEmpty())
+        {
+            summaries.clearQuick();
+            table.updateContent();
+        }
+        
+        totalLabel.setText ("Server not started", dontSendNotification);
+        return;
+    }
+    
+    auto& metrics = server->getMetrics();
+    const auto total = metrics.getTotal();
+    
+    summaries = metrics.getSummaries();
+    table.updateContent();
+    table.repaint();
+    
+    totalLabel.setText ("Port " + String (server->getPortNumber())
+                        + " - " + String (total.numRequests) + " requests, "
+                        + String (total.numErrors) + " errors, "
+                        + formatBytes (total.bytesSent) + " sent, first byte "
+                        + formatTime (total.getAverageTimeToFirstByteMs()) + ", total "
+                        + formatTime (total.getAverageTotalTimeMs()) + " on average",
+                        dontSendNotification);
+}
+
+//==============================================================================
+void ServerMetricsPanel::paintRowBackground (Graphics& g, int rowNumber, int width, int height, bool rowIsSelected)
+{
+    const Colour alternateColour (getLookAndFeel().findColour (ListBox::backgroundColourId)
+                                  .interpolatedWith (getLookAndFeel().findColour (ListBox::textColourId), 0.03f));
+    if (rowIsSelected)
+        g.fillAll (Colours::grey.withMultipliedAlpha (0.5f));
+    else if (rowNumber % 2)
+        g.fillAll (alternateColour);
+}
+
+void ServerMetricsPanel::paintCell (Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
+{
+    if (! isPositiveAndBelow (rowNumber, summaries.size()))
+        return;
+    
+    const auto& s = summaries.getReference (rowNumber);
+    String text;
+    
+    switch (columnId)
+    {
+        case pathColumn:                text = s.path; break;
+        case requestsColumn:            text = String (s.numRequests); break;
+        case statusColumn:              text = String (s.lastStatus); break;
+        case bytesColumn:               text = formatBytes (s.bytesSent); break;
+        case timeToFirstByteColumn:     text = formatTime (s.getAverageTimeToFirstByteMs()); break;
+        case totalTimeColumn:           text = formatTime (s.getAverageTotalTimeMs()); break;
+        case maxTotalTimeColumn:        text = formatTime (s.maxTotalTimeMs); break;
+        default: break;
+    }
+    
+    const Colour c (getLookAndFeel().findColour (ListBox::textColourId));
+    
+    g.setFont (Font (12.0f));
+    g.setColour (s.numErrors > 0 ? Colours::red.interpolatedWith (c, 0.3f) : c);
+    g.drawText (text, 2, 0, width - 2, height, Justification::centredLeft, true);
+}
+
+String ServerMetricsPanel::formatBytes (int64 numBytes)
+{
+    if (numBytes < 1024)
+        return String (numBytes) + " B";
+    
+    if (numBytes < 1024 * 1024)
+        return String (numBytes / 1024.0, 1) + " KB";
+    
+    return String (numBytes / (1024.0 * 1024.0), 1) + " MB";
+}
+
+String ServerMetricsPanel::formatTime (double ms)
+{
+    return ms < 10.0 ? String (ms, 2) + " ms" : String (roundToInt (ms)) + " ms";
+}
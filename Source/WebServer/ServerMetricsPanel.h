@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Panel.h"
+#include "ServerMetrics.h"
+
+class Project;
+
+/** \brief Live summary of the requests answered by the browser test server, by path. */
+class ServerMetricsPanel :  public Panel,
+                            public TableListBoxModel,
+                            private Timer
+{
+public:
+    ServerMetricsPanel (Project& p);
+    
+    void resized() override;
+    
+    int getNumRows() override { return summaries.size(); }
+    void paintRowBackground (Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override;
+    void paintCell (Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
+    
+private:
+    void timerCallback() override;
+    
+    static String formatBytes (int64 numBytes);
+    static String formatTime (double ms);
+    
+    enum ColumnIds
+    {
+        pathColumn = 1,
+        requestsColumn,
+        statusColumn,
+        bytesColumn,
+        timeToFirstByteColumn,
+        totalTimeColumn,
+        maxTotalTimeColumn
+    };
+    
+    Project& project;
+    TableListBox table;
+    Label totalLabel;
+    
+    Array<ServerMetrics::Summary> summaries;
+    
+    enum { timerInterval = 500 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ServerMetricsPanel)
+};
@@ -9,21 +9,581 @@
 */
 
 #include "WebServer.h"
+#include "ContentHash.h"
 
-LocalServer::LocalServer (File directory, int port) : portNumber (port), dir (directory)
+//==============================================================================
+// Keeps the live reload connections open and writes the events to them on its own thread, so
+// that the open pages don't hold any of the request workers.
+class LocalServer::EventStream   : private Thread
 {
-    portNumber = portNumberManager->getAvailablePortNumber (portNumber, true);
+public:
+    EventStream (int keepAliveInterval) : Thread ("Live reload stream"), keepAliveIntervalMs (keepAliveInterval)
+    {
+        startThread();
+    }
     
-    server = new Mongoose::Server (portNumber, directory.getFullPathName().getCharPointer());
-    server->registerController (this);
-    server->start();
+    ~EventStream()
+    {
+        stopThread (2000);
+    }
+    
+    // Takes ownership of the connection, which already knows the given version
+    void add (StreamingSocket* connection, int knownVersion)
+    {
+        const ScopedLock sl (lock);
+        connections.add (new Connection { connection, knownVersion });
+    }
+    
+    // Sent to the connections that don't know this version yet
+    void post (int eventVersion, const String& event)
+    {
+        {
+            const ScopedLock sl (lock);
+            pendingEvents.add ({ eventVersion, event });
+        }
+        
+        notify();
+    }
+    
+    int getNumOpenConnections()
+    {
+        const ScopedLock sl (lock);
+        removeClosedConnections();
+        return connections.size();
+    }
+    
+private:
+    struct Connection
+    {
+        ScopedPointer<StreamingSocket> socket;
+        int version;
+    };
+    
+    struct Event
+    {
+        int version;
+        String text;
+    };
+    
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            const bool notified = wait (keepAliveIntervalMs);
+            
+            const ScopedLock sl (lock);
+            removeClosedConnections();
+            
+            // Comments keep idle streams from being closed by the browser or a proxy
+            if (! notified)
+                for (int i = connections.size(); --i >= 0;)
+                    if (! send (*connections.getUnchecked (i), ":\n\n"))
+                        connections.remove (i);
+            
+            for (auto& event : pendingEvents)
+            {
+                for (int i = connections.size(); --i >= 0;)
+                {
+                    auto& c = *connections.getUnchecked (i);
+                    
+                    if (c.version >= event.version)
+                        continue;
+                    
+                    if (send (c, event.text))
+                        c.version = event.version;
+                    else
+                        connections.remove (i);
+                }
+            }
+            
+            pendingEvents.clearQuick();
+        }
+    }
+    
+    static bool send (Connection& c, const String& text)
+    {
+        const int numBytes = (int) text.getNumBytesAsUTF8();
+        return c.socket->write (text.toRawUTF8(), numBytes) == numBytes;
+    }
+    
+    // The pages never send anything on their stream: a readable connection was closed
+    void removeClosedConnections()
+    {
+        for (int i = connections.size(); --i >= 0;)
+        {
+            auto& socket = *connections.getUnchecked (i)->socket;
+            
+            if (socket.waitUntilReady (true, 0) == 0)
+                continue;
+            
+            char unexpected[256];
+            
+            if (socket.read (unexpected, sizeof (unexpected), false) <= 0)
+                connections.remove (i);
+        }
+    }
+    
+    const int keepAliveIntervalMs;
+    
+    OwnedArray<Connection> connections;
+    Array<Event> pendingEvents;
+    CriticalSection lock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EventStream)
+};
+
+//==============================================================================
+LocalServer::LocalServer (File directory, int port)
+    : eventStream (new EventStream (keepAliveIntervalMs)), server (*this, numWorkers), portNumber (port), dir (directory)
+{
+    // Ports taken by other applications are skipped as well
+    for (int attempt = 0; attempt < 20; ++attempt)
+    {
+        portNumber = portNumberManager->getAvailablePortNumber (port, true);
+        
+        if (server.start (portNumber))
+            break;
+        
+        portNumberManager->portNumbers.removeFirstMatchingValue (portNumber);
+        port = portNumber + 1;
+    }
 }
 
 LocalServer::~LocalServer()
 {
+    // Stops the workers before the file table goes away
+    server.stop();
     portNumberManager->portNumbers.removeFirstMatchingValue (portNumber);
 }
 
+//==============================================================================
+void LocalServer::setFiles (const ReferenceCountedArray<ServedFile>& files)
+{
+    HashMap<String, Entry> newFiles;
+    
+    for (auto f : files)
+    {
+        Entry entry { f, getSignature (*f), f->source == File() ? Time() : f->source.getLastModificationTime() };
+        newFiles.set (f->path, entry);
+    }
+    
+    // The previous files are released outside of the lock
+    const ScopedLock sl (servedFilesLock);
+    
+    StringArray changedPaths;
+    const Time now (Time::getCurrentTime());
+    
+    for (HashMap<String, Entry>::Iterator i (newFiles); i.next();)
+    {
+        auto& entry = newFiles.getReference (i.getKey());
+        
+        if (servedFiles.contains (i.getKey()) && servedFiles[i.getKey()].signature == entry.signature)
+        {
+            // Unchanged content keeps its date, so that conditional requests still match
+            if (entry.file->source == File())
+                entry.lastModified = servedFiles[i.getKey()].lastModified;
+        }
+        else
+        {
+            if (entry.file->source == File())
+                entry.lastModified = now;
+            
+            changedPaths.add (i.getKey());
+        }
+    }
+    
+    for (HashMap<String, Entry>::Iterator i (servedFiles); i.next();)
+        if (! newFiles.contains (i.getKey()))
+            changedPaths.add (i.getKey());
+    
+    if (! changedPaths.isEmpty())
+    {
+        ++version;
+        
+        for (auto& path : changedPaths)
+            versionOfLastChange.set (path, version);
+        
+        // Posted under the lock, so that a stream being opened gets either this event or the
+        // same changes when it is added, see connectionKept()
+        eventStream->post (version, createEvent (version, false, changedPaths));
+    }
+    
+    servedFiles.swapWith (newFiles);
+    
+    // Compressed variants of contents that aren't served anymore
+    HashMap<String, bool> signatures;
+    
+    for (HashMap<String, Entry>::Iterator i (servedFiles); i.next();)
+        signatures.set (i.getValue().signature, true);
+    
+    StringArray unusedVariants;
+    
+    for (HashMap<String, ServedFile::Ptr>::Iterator i (gzipCache); i.next();)
+        if (! signatures.contains (i.getKey()))
+            unusedVariants.add (i.getKey());
+    
+    for (auto& key : unusedVariants)
+        gzipCache.remove (key);
+}
+
+String LocalServer::getSignature (const ServedFile& file)
+{
+    if (file.source != File())
+        return String (file.source.getSize()) + "-" + String (file.source.getLastModificationTime().toMilliseconds());
+    
+    ContentHash hash;
+    hash.update (file.content.getData(), file.content.getSize());
+    return hash.toHexString();
+}
+
+//==============================================================================
+void LocalServer::stream (const HttpServer::Request&, HttpServer::Response& response)
+{
+    response.setHeader ("Content-Type", "text/event-stream");
+    response.setHeader ("Cache-Control", "no-cache");
+    
+    // Used by EventSource to open the stream again when it breaks
+    response.body << "retry: " << (int) streamRetryDelayMs << "\n\n";
+    response.keepConnection = true;
+}
+
+void LocalServer::connectionKept (const HttpServer::Request& request, StreamingSocket* connection)
+{
+    ScopedPointer<StreamingSocket> socket (connection);
+    
+    // EventSource sends the id of the last event it got when it opens the stream again
+    const String lastEventId (request.getHeader ("Last-Event-ID"));
+    const int pageVersion = lastEventId.isNotEmpty() ? lastEventId.getIntValue()
+                                                     : request.getParameter ("version", "-1").getIntValue();
+    
+    const ScopedLock sl (servedFilesLock);
+    
+    if (pageVersion != version)
+    {
+        StringArray changedPaths;
+        
+        if (pageVersion >= 0)
+            for (HashMap<String, int>::Iterator i (versionOfLastChange); i.next();)
+                if (i.getValue() > pageVersion)
+                    changedPaths.add (i.getKey());
+        
+        // A page newer than the server was generated by a previous server: it can only reload
+        const String event (createEvent (version, pageVersion > version, changedPaths));
+        const int numBytes = (int) event.getNumBytesAsUTF8();
+        
+        if (socket->write (event.toRawUTF8(), numBytes) != numBytes)
+            return;
+    }
+    
+    eventStream->add (socket.release(), version);
+}
+
+String LocalServer::createEvent (int eventVersion, bool reload, const StringArray& changedPaths)
+{
+    DynamicObject::Ptr changes (new DynamicObject());
+    changes->setProperty ("version", eventVersion);
+    changes->setProperty ("reload", reload);
+    
+    Array<var> paths;
+    
+    for (auto& path : changedPaths)
+        paths.add (path);
+    
+    changes->setProperty ("changed", paths);
+    
+    return "id: " + String (eventVersion) + "\n" + "data: " + JSON::toString (var (changes.get()), true) + "\n\n";
+}
+
+bool LocalServer::hasConnectedPages() const
+{
+    return eventStream->getNumOpenConnections() > 0;
+}
+
+bool LocalServer::findEntry (const String& urlPath, Entry& result) const
+{
+    // "/js/audio.js" -> "js/audio.js"
+    auto path = urlPath.trimCharactersAtStart ("/");
+    
+    if (path.isEmpty())
+        path = "index.html";
+    
+    {
+        const ScopedLock sl (servedFilesLock);
+        
+        if (servedFiles.contains (path))
+        {
+            result = servedFiles[path];
+            return true;
+        }
+    }
+    
+    // Then the directory's files, which can't be reached with ".."
+    const auto f = dir.getChildFile (path);
+    
+    if (! f.existsAsFile() || ! f.isAChildOf (dir))
+        return false;
+    
+    ServedFile::Ptr file (new ServedFile (path, f));
+    result = { file, getSignature (*file), f.getLastModificationTime() };
+    return true;
+}
+
+//==============================================================================
+void LocalServer::handleRequest (const HttpServer::Request& request, HttpServer::Response& response)
+{
+    if (request.method != "GET" && request.method != "HEAD")
+    {
+        response.code = 405;
+        return;
+    }
+    
+    if (request.path == "/live")
+    {
+        stream (request, response);
+        return;
+    }
+    
+    if (request.path == "/metrics.json")
+    {
+        response.setHeader ("Content-Type", "application/json");
+        response.setHeader ("Cache-Control", "no-cache");
+        response.body << JSON::toString (metrics.toJSON());
+        return;
+    }
+    
+    Entry entry;
+    
+    if (findEntry (request.path, entry))
+        serveFile (request, entry, response);
+    else
+        response.code = 404;
+}
+
+void LocalServer::requestServed (const HttpServer::Request& request, const HttpServer::Response& response,
+                                 const HttpServer::Stats& stats)
+{
+    if (request.path == "/live" || request.path == "/metrics.json")
+        return;
+    
+    ServerMetrics::Request r;
+    r.path = request.path;
+    r.status = response.code;
+    r.bytesSent = stats.bytesSent;
+    r.timeToFirstByteMs = stats.timeToFirstByteMs;
+    r.totalTimeMs = stats.totalTimeMs;
+    
+    metrics.add (r);
+}
+
+//==============================================================================
+// RFC 7231 date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+static String formatHttpDate (Time time)
+{
+    static const char* const days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char* const months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    
+    const Time utc (time.toMilliseconds() - (int64) time.getUTCOffsetSeconds() * 1000);
+    
+    return String (days[utc.getDayOfWeek()]) + ", "
+         + String (utc.getDayOfMonth()).paddedLeft ('0', 2) + " "
+         + months[utc.getMonth()] + " "
+         + String (utc.getYear()) + " "
+         + String (utc.getHours()).paddedLeft ('0', 2) + ":"
+         + String (utc.getMinutes()).paddedLeft ('0', 2) + ":"
+         + String (utc.getSeconds()).paddedLeft ('0', 2) + " GMT";
+}
+
+Range<int64> LocalServer::parseByteRange (const String& header, int64 size)
+{
+    const Range<int64> wholeFile (0, size);
+    
+    if (! header.startsWithIgnoreCase ("bytes=") || header.containsChar (','))
+        return wholeFile;
+    
+    const String spec (header.fromFirstOccurrenceOf ("=", false, false).trim());
+    const String first (spec.upToFirstOccurrenceOf ("-", false, false).trim());
+    const String last (spec.fromFirstOccurrenceOf ("-", false, false).trim());
+    
+    if (! spec.containsChar ('-') || (first.isEmpty() && last.isEmpty())
+        || ! first.containsOnly ("0123456789") || ! last.containsOnly ("0123456789"))
+        return wholeFile;
+    
+    // "bytes=-500": the last 500 bytes
+    if (first.isEmpty())
+        return Range<int64> (jmax ((int64) 0, size - last.getLargeIntValue()), size);
+    
+    const int64 start = first.getLargeIntValue();
+    
+    // "bytes=500-100" is invalid rather than unsatisfiable, the header is ignored then
+    if (last.isNotEmpty() && last.getLargeIntValue() < start)
+        return wholeFile;
+    
+    if (start >= size)
+        return Range<int64>();
+    
+    const int64 end = last.isEmpty() ? size : jmin (size, last.getLargeIntValue() + 1);
+    return Range<int64> (start, end);
+}
+
+void LocalServer::serveFile (const HttpServer::Request& request, const Entry& entry, HttpServer::Response& response)
+{
+    const auto& file = *entry.file;
+    const String mimeType (getMimeType (file.path));
+    const String etag (entry.signature.quoted());
+    const String lastModified (formatHttpDate (entry.lastModified));
+    
+    response.setHeader ("Content-Type", mimeType);
+    response.setHeader ("ETag", etag);
+    response.setHeader ("Last-Modified", lastModified);
+    response.setHeader ("Accept-Ranges", "bytes");
+    
+    // Pages always revalidate, which costs a 304 when nothing changed
+    response.setHeader ("Cache-Control", "no-cache");
+    
+    if (isCompressible (mimeType))
+        response.setHeader ("Vary", "Accept-Encoding");
+    
+    // If-None-Match wins over If-Modified-Since when both are given.
+    // Browsers send back the date they were given.
+    const String ifNoneMatch (request.getHeader ("If-None-Match"));
+    const bool notModified = ifNoneMatch.isNotEmpty() ? matchesEntityTag (ifNoneMatch, etag)
+                                                      : request.getHeader ("If-Modified-Since") == lastModified;
+    
+    if (notModified)
+    {
+        response.code = 304;
+        return;
+    }
+    
+    const int64 size = file.source != File() ? file.source.getSize() : (int64) file.content.getSize();
+    const String rangeHeader (request.getHeader ("Range"));
+    Range<int64> range (0, size);
+    
+    if (rangeHeader.isNotEmpty())
+    {
+        range = parseByteRange (rangeHeader, size);
+        
+        if (range.isEmpty() && size > 0)
+        {
+            response.code = 416;
+            response.setHeader ("Content-Range", "bytes */" + String (size));
+            return;
+        }
+        
+        if (range.getLength() != size)
+        {
+            response.code = 206;
+            response.setHeader ("Content-Range", "bytes " + String (range.getStart()) + "-" + String (range.getEnd() - 1)
+                                                   + "/" + String (size));
+        }
+    }
+    
+    // Ranges are always served from the identity encoding
+    if (range.getLength() == size && request.getHeader ("Accept-Encoding").containsIgnoreCase ("gzip"))
+    {
+        if (auto gzipped = getGzippedContent (entry))
+        {
+            response.setHeader ("Content-Encoding", "gzip");
+            response.body << gzipped->content;
+            return;
+        }
+    }
+    
+    if (! setContent (file, range, response))
+    {
+        response.headers.clear();
+        response.code = 404;
+    }
+}
+
+bool LocalServer::matchesEntityTag (const String& ifNoneMatch, const String& etag)
+{
+    for (auto tag : StringArray::fromTokens (ifNoneMatch, ",", "\""))
+    {
+        tag = tag.trim();
+        
+        if (tag == "*" || tag == etag || tag == "W/" + etag)
+            return true;
+    }
+    
+    return false;
+}
+
+bool LocalServer::setContent (const ServedFile& file, Range<int64> range, HttpServer::Response& response)
+{
+    if (file.source == File())
+        return response.body.write (addBytesToPointer (file.content.getData(), range.getStart()), (size_t) range.getLength());
+    
+    // Source files are streamed by the server in chunks, from the start of the requested part,
+    // so neither a long file nor a seek in it is loaded in memory
+    ScopedPointer<FileInputStream> in (new FileInputStream (file.source));
+    
+    if (in->failedToOpen() || ! in->setPosition (range.getStart()))
+        return false;
+    
+    response.setBodyStream (in.release(), range.getLength());
+    return true;
+}
+
+LocalServer::ServedFile::Ptr LocalServer::getGzippedContent (const Entry& entry)
+{
+    const auto& file = *entry.file;
+    
+    // Audio is already compressed, and files read from their source aren't cached
+    if (file.source != File() || file.content.getSize() < 256 || ! isCompressible (getMimeType (file.path)))
+        return nullptr;
+    
+    {
+        const ScopedLock sl (servedFilesLock);
+        
+        if (gzipCache.contains (entry.signature))
+            return gzipCache[entry.signature];
+    }
+    
+    MemoryOutputStream compressed;
+    
+    {
+        GZIPCompressorOutputStream gzip (compressed, 9, GZIPCompressorOutputStream::windowBitsGZIP);
+        gzip.write (file.content.getData(), file.content.getSize());
+        gzip.flush();
+    }
+    
+    ServedFile::Ptr variant (new ServedFile (file.path, compressed.getMemoryBlock()));
+    
+    const ScopedLock sl (servedFilesLock);
+    gzipCache.set (entry.signature, variant);
+    return variant;
+}
+
+bool LocalServer::isCompressible (const String& mimeType)
+{
+    return mimeType.startsWith ("text/") || mimeType.contains ("javascript") || mimeType.contains ("json");
+}
+
+String LocalServer::getMimeType (const String& path)
+{
+    static const char* const types[] =
+    {
+        ".html",    "text/html; charset=utf-8",
+        ".js",      "application/javascript; charset=utf-8",
+        ".css",     "text/css; charset=utf-8",
+        ".json",    "application/json",
+        ".wav",     "audio/wav",
+        ".mp3",     "audio/mpeg",
+        ".ogg",     "audio/ogg",
+        ".flac",    "audio/flac",
+        ".m4a",     "audio/mp4",
+        ".aif",     "audio/aiff",
+        ".aiff",    "audio/aiff"
+    };
+    
+    for (int i = 0; i < numElementsInArray (types); i += 2)
+        if (path.endsWithIgnoreCase (types[i]))
+            return types[i + 1];
+    
+    return "application/octet-stream";
+}
+
 int LocalServer::PortNumberManager::getAvailablePortNumber (int desiredPort, bool addFound)
 {
     if (portNumbers.contains (desiredPort))
@@ -11,25 +11,113 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "HttpServer.h"
+#include "ServerMetrics.h"
 
-class LocalServer   : public Mongoose::WebController
+// Serves the browser test: the files of its table first, then the files of its directory.
+// Requests are answered by a bounded pool of workers, so that a long download doesn't hold
+// the other pages' requests. The pages' live reload streams stay open on a thread of their own.
+class LocalServer   : private HttpServer::Handler
 {
 public:
     //==============================================================================
     LocalServer (File directory, int port = 8080);    
     ~LocalServer();
     
-    void stream (Mongoose::Request &request, Mongoose::StreamResponse &response) {}
+    // Server-Sent Events channel of the test pages (see livereload.js). The connection stays open:
+    // a page first gets the files that changed since the version it knows (its Last-Event-ID, or
+    // "/live?version=<n>"), then an event each time setFiles() changes something.
+    void stream (const HttpServer::Request& request, HttpServer::Response& response);
+    
+    // True when a test page's stream is open, so that a new generation reaches it without
+    // opening another page
+    bool hasConnectedPages() const;
     
     File getDirectory() const { return dir; }
     
     int getPortNumber() const { return portNumber; }
     
+    // Every request but the live reload stream and the metrics themselves, which pages poll.
+    // Also served as JSON on "/metrics.json".
+    ServerMetrics& getMetrics() { return metrics; }
+    
+    //==============================================================================
+    // A file served without being written in the server's directory: either its content is
+    // held in memory or it is read from its source file on each request.
+    // Served files get an ETag and a Last-Modified date, so that pages revalidate them with
+    // conditional requests, and they accept byte ranges. Text files held in memory are sent
+    // gzipped to the browsers that accept it.
+    struct ServedFile  : public ReferenceCountedObject
+    {
+        typedef ReferenceCountedObjectPtr<ServedFile> Ptr;
+        
+        ServedFile (const String& p, const MemoryBlock& c) : path (p), content (c) {}
+        ServedFile (const String& p, const File& s) : path (p), source (s) {}
+        
+        const String path;      // relative to the server's root, e.g. "js/audio.js"
+        const MemoryBlock content;
+        const File source;
+    };
+    
+    // Replaces the whole file table at once. These files take precedence over the directory's
+    // ones. Can be called while the server is running. When some files changed, added or removed,
+    // the connected pages are notified.
+    void setFiles (const ReferenceCountedArray<ServedFile>& files);
+    
+    //==============================================================================
+    // Single "bytes=" range of a Range header. Returns the whole file when the header can't be
+    // used, and an empty range when it can't be satisfied.
+    static Range<int64> parseByteRange (const String& header, int64 size);
+    
+    // True when an If-None-Match header lists the quoted etag, weakly or not, or is "*"
+    static bool matchesEntityTag (const String& ifNoneMatch, const String& etag);
+    
 private:
-    ScopedPointer<Mongoose::Server> server;
+    struct Entry
+    {
+        ServedFile::Ptr file;
+        String signature;       // content hash, or size and date of a source file
+        Time lastModified;
+    };
+    
+    void handleRequest (const HttpServer::Request& request, HttpServer::Response& response) override;
+    void requestServed (const HttpServer::Request& request, const HttpServer::Response& response,
+                        const HttpServer::Stats& stats) override;
+    void connectionKept (const HttpServer::Request& request, StreamingSocket* connection) override;
+    void serveFile (const HttpServer::Request& request, const Entry& entry, HttpServer::Response& response);
+    
+    bool findEntry (const String& urlPath, Entry& result) const;
+    ServedFile::Ptr getGzippedContent (const Entry& entry);
+    static bool setContent (const ServedFile& file, Range<int64> range, HttpServer::Response& response);
+    static String getMimeType (const String& path);
+    static bool isCompressible (const String& mimeType);
+    static String getSignature (const ServedFile& file);
+    static String createEvent (int eventVersion, bool reload, const StringArray& changedPaths);
+    
+    class EventStream;
+    ScopedPointer<EventStream> eventStream;
+    
+    HttpServer server;
     int portNumber;
     File dir;
     
+    ServerMetrics metrics;
+    
+    HashMap<String, Entry> servedFiles;
+    CriticalSection servedFilesLock;
+    
+    // Guarded by servedFilesLock
+    HashMap<String, ServedFile::Ptr> gzipCache;     // keyed by content hash
+    int version = 0;
+    HashMap<String, int> versionOfLastChange;
+    
+    enum
+    {
+        numWorkers = 8,
+        streamRetryDelayMs = 1000,
+        keepAliveIntervalMs = 15000
+    };
+    
     struct PortNumberManager
     {
         Array<int> portNumbers;